@@ -1,8 +1,7 @@
 #include <p18f26k22.h>
 #include "clock_lib.h"
+#include "dither.h"
 
-extern char GAMMA_TABLE_L[128];
-extern char GAMMA_TABLE_H[128];
 
 extern unsigned char MINUTES;
 extern unsigned char HOURS;
@@ -12,16 +11,11 @@ extern unsigned char HOURS;
 #define FADING_OUT	1
 #define FADING_IN	2
 
-void clearArray(unsigned char *array, unsigned char LED_NO);
-void setArray(unsigned char *array, unsigned char LED_NO);
 
-unsigned char startFading(unsigned char UNIVERSAL_BRIGHTNESS, unsigned char *FADING_BRIGHTNESS)
+unsigned char startFading(unsigned int UNIVERSAL_LEVEL, unsigned int *FADING_LEVEL)
 {
-	// Turn on CCP2, initially with the same brightness as the global
-	CCPR2H = GAMMA_TABLE_H[UNIVERSAL_BRIGHTNESS];
-	CCPR2L = GAMMA_TABLE_L[UNIVERSAL_BRIGHTNESS];
-	CCP2CON = 0x0A;
-	*FADING_BRIGHTNESS = UNIVERSAL_BRIGHTNESS;
+	// CCP2 is loaded and turned on by the timer 1 interrupt at the start of the next period.
+	*FADING_LEVEL = UNIVERSAL_LEVEL;
 	return FADING_OUT;	
 }
 
@@ -123,87 +117,29 @@ void quickSwitch(unsigned char *SHIFT_REGISTER_OUTPUTS)
 	}
 }
 
-void rebuildDisplay(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *INCOMING_LEDS, unsigned char *FADING_MARKS)
+void markChanges(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *target,
+				 unsigned char *FADING_MARKS, unsigned char *INCOMING_LEDS)
 {
-	unsigned char i, j;
-	unsigned char builtDisplay[4] = {0x00, 0x00, 0x00, 0x00};
-	// All of the following must be assigned locations, from 0-31, in definitions above.
-	// Positions correspond to the shift array outputs.
-	unsigned char HOUR_POSITIONS[] = {	HOUR_TWELVE, HOUR_ONE, HOUR_TWO, HOUR_THREE, 
-										HOUR_FOUR, HOUR_FIVE, HOUR_SIX, HOUR_SEVEN, 
-										HOUR_EIGHT, HOUR_NINE, HOUR_TEN, HOUR_ELEVEN	};
-
-	// Built the new display based on the time.
-	setArray(builtDisplay, IT_IS);
+	unsigned char i;
 
-	if(MINUTES >= 0 && MINUTES < 5)
+	// Bits that change from 0 to 1 are incoming, and bits that change from 1 to 0 fade.
+	for(i = 0; i < 4; i++)
 	{
-		setArray(builtDisplay, MINUTES_OCLOCK);
-		setArray(builtDisplay, HOUR_POSITIONS[HOURS]);
-	} else if (MINUTES >= 5 && MINUTES < 10) {
-		setArray(builtDisplay, MINUTES_FIVE);
-		setArray(builtDisplay, CONSTRUCTORS_PAST);
-		setArray(builtDisplay, HOUR_POSITIONS[HOURS]);
-	} else if (MINUTES >= 10 && MINUTES < 15) {
-		setArray(builtDisplay, MINUTES_TEN);
-		setArray(builtDisplay, CONSTRUCTORS_PAST);
-		setArray(builtDisplay, HOUR_POSITIONS[HOURS]);
-	} else if (MINUTES >= 15 && MINUTES < 20) {
-		setArray(builtDisplay, CONSTRUCTORS_A);
-		setArray(builtDisplay, MINUTES_QUARTER);
-		setArray(builtDisplay, CONSTRUCTORS_PAST);
-		setArray(builtDisplay, HOUR_POSITIONS[HOURS]);
-	} else if (MINUTES >= 20 && MINUTES < 25) {
-		setArray(builtDisplay, MINUTES_TWENTY);
-		setArray(builtDisplay, CONSTRUCTORS_PAST);
-		setArray(builtDisplay, HOUR_POSITIONS[HOURS]);
-	} else if (MINUTES >= 25 && MINUTES < 30) {
-		setArray(builtDisplay, MINUTES_FIVE);
-		setArray(builtDisplay, MINUTES_TWENTY);
-		setArray(builtDisplay, CONSTRUCTORS_PAST);
-		setArray(builtDisplay, HOUR_POSITIONS[HOURS]);
-	} else if (MINUTES >= 30 && MINUTES < 35) {
-		setArray(builtDisplay, MINUTES_HALF);
-		setArray(builtDisplay, CONSTRUCTORS_PAST);
-		setArray(builtDisplay, HOUR_POSITIONS[HOURS]);
-	} else if (MINUTES >= 35 && MINUTES < 40) {
-		setArray(builtDisplay, MINUTES_FIVE);
-		setArray(builtDisplay, MINUTES_TWENTY);
-		setArray(builtDisplay, CONSTRUCTORS_OF);
-		setArray(builtDisplay, HOUR_POSITIONS[(HOURS + 1) % 12]);
-	} else if (MINUTES >= 40 && MINUTES < 45) {
-		setArray(builtDisplay, MINUTES_TWENTY);
-		setArray(builtDisplay, CONSTRUCTORS_OF);
-		setArray(builtDisplay, HOUR_POSITIONS[(HOURS + 1) % 12]);
-	} else if (MINUTES >= 45 && MINUTES < 50) {
-		setArray(builtDisplay, CONSTRUCTORS_A);
-		setArray(builtDisplay, MINUTES_QUARTER);
-		setArray(builtDisplay, CONSTRUCTORS_OF);
-		setArray(builtDisplay, HOUR_POSITIONS[(HOURS + 1) % 12]);
-	} else if (MINUTES >= 50 && MINUTES < 55) {
-		setArray(builtDisplay, MINUTES_TEN);
-		setArray(builtDisplay, CONSTRUCTORS_OF);
-		setArray(builtDisplay, HOUR_POSITIONS[(HOURS + 1) % 12]);
-	} else if (MINUTES >= 55 && MINUTES < 60) {
-		setArray(builtDisplay, MINUTES_FIVE);
-		setArray(builtDisplay, CONSTRUCTORS_OF);
-		setArray(builtDisplay, HOUR_POSITIONS[(HOURS + 1) % 12]);
+		INCOMING_LEDS[i] |= target[i] & ~SHIFT_REGISTER_OUTPUTS[i];
+		FADING_MARKS[i] &= ~(SHIFT_REGISTER_OUTPUTS[i] & ~target[i]);
 	}
+}
 
-	//Go through bit by bit and see which change from 0 to 1 (incoming) and 1 to 0 (fading)
+void fadeAll(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *FADING_MARKS, unsigned char *INCOMING_LEDS)
+{
+	unsigned char i;
+
+	// The target is whatever switchFades would have produced. Fade everything out, then all of it back in.
 	for(i = 0; i < 4; i++)
 	{
-		for(j = 0; j < 8; j++)
-		{
-			if(((builtDisplay[i] >> j) & 0x01) > ((SHIFT_REGISTER_OUTPUTS[i] >> j) & 0x01))
-			{
-				INCOMING_LEDS[i] |= (1 << j);
-			}
-			else if(((builtDisplay[i] >> j) & 0x01) < ((SHIFT_REGISTER_OUTPUTS[i] >> j) & 0x01))
-				FADING_MARKS[i] &= (0xFF - (1 << j));
-		}
+		INCOMING_LEDS[i] = (SHIFT_REGISTER_OUTPUTS[i] & FADING_MARKS[i]) | INCOMING_LEDS[i];
+		FADING_MARKS[i] = 0x00;
 	}
-
 }
 
 void setArray(unsigned char *array, unsigned char LED_NO)
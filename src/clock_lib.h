@@ -41,11 +41,12 @@ Because of this, the parameters being passed to them cooincide with many main.c
 
 /**
 @brief This function triggers the beginning of a fade out event.
-@param UNIVERSAL_BRIGHTNESS	Passes a brightness value, 0-255 that the LEDs are running at.
-@param FADING_BRIGHTNESS	Passes a pointer to the start value of a fade.
+The fade starts at UNIVERSAL_LEVEL. CCP2 is left alone, for the timer 1 interrupt to load at the period boundary.
+@param UNIVERSAL_LEVEL	Passes the dithered brightness level (see dither.h) that the LEDs are running at.
+@param FADING_LEVEL		Passes a pointer to the start level of a fade.
 @return Returns the OPSTATUS of FADING_OUT
 */
-unsigned char startFading(unsigned char UNIVERSAL_BRIGHTNESS, unsigned char *FADING_BRIGHTNESS);
+unsigned char startFading(unsigned int UNIVERSAL_LEVEL, unsigned int *FADING_LEVEL);
 
 
 
@@ -76,17 +77,41 @@ unsigned char doneFading(unsigned char *FADING_MARKS, unsigned char *INCOMING_LE
 void quickSwitch(unsigned char *SHIFT_REGISTER_OUTPUTS);
 
 /**
-@brief	Used to rebuild the LED array to be used with the startFading function.
+@brief	Marks the LEDs that differ between the current display and a target, ready for startFading.
 @param SHIFT_REGISTER_OUTPUTS	Points to the main array of 4 unsigned chars containing which LEDs are on.
+@param target			Points to an array of 4 unsigned chars containing which LEDs should be on.
 @param FADING_MARKS		Points to the array of 4 unsigned chars containing which LEDs are being faded out.
 @param INCOMING_LEDS		Points to the array of 4 unsigned chars containing which LEDs are to be faded in.
 
-This function builds the FADING_MARKS and INCOMING_LEDS variables based on the HOURS and MINUTES global variables.
-It does this by first building an array of what lights SHOULD be on, then comparing this to what lights ARE on.
-If a LED is on but should be off, FADING_MARKS will be modified so that on startFading this LED will fade.
-Alternatively, if a LED is off but should be on, it is added to INCOMING_LEDS so that when switchFades is called,
-the selected LEDs will begin fading in. 
+LEDs that are on but should be off are cleared in FADING_MARKS, and LEDs that are off but should be on are set in
+INCOMING_LEDS.
 */
-void rebuildDisplay(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *INCOMING_LEDS, unsigned char *FADING_MARKS);
+void markChanges(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *target,
+				 unsigned char *FADING_MARKS, unsigned char *INCOMING_LEDS);
+
+/**
+@brief	Marks every LED for fading, so that the whole face fades out and the pending display fades back in.
+@param SHIFT_REGISTER_OUTPUTS	Points to the main array of 4 unsigned chars containing which LEDs are on.
+@param FADING_MARKS		Points to the array of 4 unsigned chars containing which LEDs are being faded out.
+@param INCOMING_LEDS		Points to the array of 4 unsigned chars containing which LEDs are to be faded in.
+
+Any changes already marked by markChanges are kept; they simply become part of the full fade.
+This must be called before the fade reaches switchFades.
+*/
+void fadeAll(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *FADING_MARKS, unsigned char *INCOMING_LEDS);
+
+/**
+@brief	Sets the bit for one LED in an array of 4 unsigned chars.
+@param array	The array.
+@param LED_NO	The LED position.
+*/
+void setArray(unsigned char *array, unsigned char LED_NO);
+
+/**
+@brief	Clears the bit for one LED in an array of 4 unsigned chars.
+@param array	The array.
+@param LED_NO	The LED position.
+*/
+void clearArray(unsigned char *array, unsigned char LED_NO);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "compositor.h"
+
+//! The layer masks.
+static unsigned char LAYERS[COMPOSITOR_LAYERS][4] =
+{
+	{0x00, 0x00, 0x00, 0x00},
+	{0x00, 0x00, 0x00, 0x00},
+	{0x00, 0x00, 0x00, 0x00},
+	{0x00, 0x00, 0x00, 0x00}
+};
+
+//! One bit for each layer changed since the last compose().
+static unsigned char LAYERS_DIRTY = 0;
+
+void layerSet(unsigned char layer, unsigned char *frame)
+{
+	unsigned char i;
+
+	for(i = 0; i < 4; i++)
+	{
+		if(LAYERS[layer][i] != frame[i])
+		{
+			LAYERS[layer][i] = frame[i];
+			LAYERS_DIRTY |= 1 << layer;
+		}
+	}
+}
+
+void layerClear(unsigned char layer)
+{
+	unsigned char i;
+
+	for(i = 0; i < 4; i++)
+	{
+		if(LAYERS[layer][i])
+		{
+			LAYERS[layer][i] = 0x00;
+			LAYERS_DIRTY |= 1 << layer;
+		}
+	}
+}
+
+unsigned char compose(unsigned char *frame)
+{
+	unsigned char i;
+
+	if(!LAYERS_DIRTY)
+		return 0;
+
+	for(i = 0; i < 4; i++)
+	{
+		frame[i] = (LAYERS[LAYER_TIME][i] | LAYERS[LAYER_MESSAGE][i] | LAYERS[LAYER_PREVIEW][i])
+					& ~LAYERS[LAYER_BLINK][i];
+	}
+	LAYERS_DIRTY = 0;
+	return 1;
+}
+
+void composeUnblinked(unsigned char *frame)
+{
+	unsigned char i;
+
+	for(i = 0; i < 4; i++)
+		frame[i] = LAYERS[LAYER_TIME][i] | LAYERS[LAYER_MESSAGE][i] | LAYERS[LAYER_PREVIEW][i];
+}
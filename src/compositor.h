@@ -0,0 +1,48 @@
+/**
+@file compositor.h
+@brief Builds the display from a stack of layers, and only rebuilds it when a layer has changed.
+
+Each layer is a 4 byte LED mask. The display is the time layer, with the message and preview layers ORed over it, and
+then the LEDs in the blink layer taken out. Setting a layer to what it already holds doesn't mark it dirty, so
+calling compose() when nothing has changed costs one test.
+*/
+
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+//!@name Layers.
+//!@{
+#define LAYER_TIME			0		//!< The words for the current time.
+#define LAYER_MESSAGE		1		//!< Lit over the time, for messages and animations.
+#define LAYER_PREVIEW		2		//!< Lit over the time, for previewing a setting.
+#define LAYER_BLINK			3		//!< Taken out of everything else, to blink words.
+#define COMPOSITOR_LAYERS	4
+//!@}
+
+/**
+@brief Sets a layer, marking it dirty if it changed.
+@param layer	One of the LAYER_ values.
+@param frame	The 4 byte mask for the layer.
+*/
+void layerSet(unsigned char layer, unsigned char *frame);
+
+/**
+@brief Empties a layer, marking it dirty if it wasn't already empty.
+@param layer	One of the LAYER_ values.
+*/
+void layerClear(unsigned char layer);
+
+/**
+@brief Rebuilds the display from the layers, if any of them are dirty.
+@param frame	Filled with the 4 byte display when it was rebuilt, and left alone otherwise.
+@return Returns 1 if the display was rebuilt, or 0 if nothing had changed.
+*/
+unsigned char compose(unsigned char *frame);
+
+/**
+@brief Builds the display without the blink layer, whether or not anything is dirty. Nothing is marked clean.
+@param frame	Filled with the 4 byte display, as it is between blinks.
+*/
+void composeUnblinked(unsigned char *frame);
+
+#endif
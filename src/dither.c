@@ -0,0 +1,16 @@
+#include "dither.h"
+
+extern const unsigned char GAMMA_TABLE_H[128];
+extern const unsigned char GAMMA_TABLE_L[128];
+
+void ditherSet(DITHER *d, unsigned int level)
+{
+	unsigned char index = level >> DITHER_BITS;
+	unsigned char next = (index < 127) ? index + 1 : 127;
+
+	d->lo_h = GAMMA_TABLE_H[index];
+	d->lo_l = GAMMA_TABLE_L[index];
+	d->hi_h = GAMMA_TABLE_H[next];
+	d->hi_l = GAMMA_TABLE_L[next];
+	d->frac = (level & (DITHER_STEPS - 1)) << (8 - DITHER_BITS);
+}
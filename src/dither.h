@@ -0,0 +1,69 @@
+/**
+@file dither.h
+@brief Temporal dithering between neighbouring gamma entries, for extra brightness resolution at the dark end.
+
+A brightness level carries DITHER_BITS of fraction below the 0-127 gamma index. Each PWM period, DITHER_NEXT adds
+the fraction to an error accumulator and uses the next gamma entry up whenever it carries, so that over several
+periods the LEDs average out to a level between the two entries. The ISR only pays for one add and one compare.
+*/
+
+#ifndef DITHER_H
+#define DITHER_H
+
+//! Fraction bits below the gamma index. 7 + 3 gives 10 bits of brightness.
+#define DITHER_BITS			3
+
+//! Fine steps between neighbouring gamma entries.
+#define DITHER_STEPS		(1 << DITHER_BITS)
+
+//! Below this gamma index, the brightness buttons and fades move in fine steps.
+#define DITHER_THRESHOLD	16
+
+//! Fine steps taken each period by a fade below DITHER_THRESHOLD.
+#define DITHER_FADE_STEP	2
+
+//! Builds a level from a gamma index and a fraction, 0 to DITHER_STEPS - 1.
+#define BRIGHTNESS_LEVEL(index, fine)	(((unsigned int)(index) << DITHER_BITS) | (fine))
+
+//! The level step a fade takes from the given level: fine near the bottom, a whole gamma entry above it.
+#define FADE_STEP(level)	((level) < BRIGHTNESS_LEVEL(DITHER_THRESHOLD, 0) ? DITHER_FADE_STEP : DITHER_STEPS)
+
+/**
+* The two compare values a level alternates between, and its accumulator.
+*/
+typedef struct
+{
+	unsigned char lo_h;		//!< High byte of the gamma entry at or below the level.
+	unsigned char lo_l;		//!< Low byte of the gamma entry at or below the level.
+	unsigned char hi_h;		//!< High byte of the next gamma entry up.
+	unsigned char hi_l;		//!< Low byte of the next gamma entry up.
+	unsigned char frac;		//!< The fraction, scaled to 0-255.
+	unsigned char acc;		//!< The error accumulator.
+} DITHER;
+
+/**
+@brief Loads the compare registers for the next period from a DITHER. Used at the start of each period.
+@param d		The DITHER to step.
+@param REGH		The compare register high byte.
+@param REGL		The compare register low byte.
+*/
+#define DITHER_NEXT(d, REGH, REGL)						\
+	do {												\
+		if((unsigned char)((d).acc += (d).frac) < (d).frac)	\
+		{												\
+			REGH = (d).hi_h;							\
+			REGL = (d).hi_l;							\
+		} else {										\
+			REGH = (d).lo_h;							\
+			REGL = (d).lo_l;							\
+		}												\
+	} while(0)
+
+/**
+@brief Works out the compare values and fraction for a level.
+@param d		The DITHER to fill in.
+@param level	The level, built with BRIGHTNESS_LEVEL.
+*/
+void ditherSet(DITHER *d, unsigned int level);
+
+#endif
@@ -1,95 +1,101 @@
-#include <i2c.h>
 #include "ds_1340.h"
+#include "rtc_bus.h"
 
-static unsigned char convert2char(unsigned char bcd);
-static unsigned char convert2bcd(unsigned char data);
+static void readRegisters(unsigned char first, unsigned char count);
+static void writeRegister(unsigned char reg, unsigned char value);
 
-typedef struct
-{
-	unsigned char seconds;
-	unsigned char hours;
-	unsigned char minutes;
-	unsigned char trickle_reg;
-	unsigned char control_reg;
-	unsigned char OSF;
-	
-} DS_1340;
+//! The last known value of every DS1340 register.
+static unsigned char DS1340_SHADOW[DS1340_REGISTERS];
 
 void initializeDS1340(DS_1340 *config)
 {
-	StartI2C2();
-	WriteI2C2( ADDR | 0x00 );
-	WriteI2C2( CONTROL_REG );
-	WriteI2C2( config -> control_reg );
-	WriteI2C2( config -> trickle_reg );
-	StopI2C2();
+	// One burst read of the whole register map fills the shadow.
+	readRegisters(SECONDS_REG, DS1340_REGISTERS);
+
+	// These only change when we write them, so they are left alone across reboots.
+	writeRegister(CONTROL_REG, config -> control_reg);
+	writeRegister(TRICKLE_REG, config -> trickle_reg);
 }
 
 void writeDS1340(DS_1340 *data_out)
 {
-	StartI2C2();
-	WriteI2C2( ADDR | 0x00 );
-	WriteI2C2( 0x00 );
-	WriteI2C2( convert2bcd(data_out->seconds) & 0x7F);
-	WriteI2C2( convert2bcd(data_out->minutes) );
-	WriteI2C2( convert2bcd(data_out->hours) );
-	StopI2C2();
+	// Keep the century bits, and always clear EOSC so the oscillator runs.
+	DS1340_SHADOW[SECONDS_REG] = bcdEncode(data_out->seconds) & SECONDS_MASK;
+	DS1340_SHADOW[MINUTES_REG] = bcdEncode(data_out->minutes);
+	DS1340_SHADOW[HOURS_REG] = (DS1340_SHADOW[HOURS_REG] & (CEB_BIT | CB_BIT)) | bcdEncode(data_out->hours);
+
+	rtcWriteRegisters(ADDR, SECONDS_REG, DS1340_SHADOW + SECONDS_REG, 3);
 }
 
 void readDS1340(DS_1340 *data_in)
 {
-	// Read data to clock_in
-	StartI2C2();
-	WriteI2C2( ADDR | 0x00 );
-	WriteI2C2( 0x01 );
-	StartI2C2();
-	WriteI2C2( ADDR | 0x01 );
-	data_in->minutes = convert2char(ReadI2C2() & MINUTES_MASK);
-	AckI2C2();
-	data_in->hours = (convert2char(ReadI2C2() & HOURS_MASK)%12);
-	NotAckI2C2();
-	StopI2C2();	
+	readRegisters(SECONDS_REG, 3);
+	data_in->seconds = bcdDecode(DS1340_SHADOW[SECONDS_REG] & SECONDS_MASK);
+	data_in->minutes = bcdDecode(DS1340_SHADOW[MINUTES_REG] & MINUTES_MASK);
+	data_in->hours = bcdDecode(DS1340_SHADOW[HOURS_REG] & HOURS_MASK);
 }
 
 void readControls(DS_1340 *data_in)
 {
-	unsigned char temp1;
-	data_in->trickle_reg = temp1;
-	data_in->control_reg = temp1;
+	unsigned char control;
+
+	readRegisters(CONTROL_REG, 3);
+	control = DS1340_SHADOW[CONTROL_REG];
+	data_in->control_reg = control;
+	data_in->trickle_reg = DS1340_SHADOW[TRICKLE_REG];
+	data_in->OSF = (DS1340_SHADOW[OSF_REG] & OSF_BIT) ? 1 : 0;
+	data_in->FT = (control & FT_ON) ? 1 : 0;
+	if(control & CAL_S_POS)
+		data_in->calibration = control & CAL_MASK;
+	else
+		data_in->calibration = -(signed char)(control & CAL_MASK);
+}
+
+void setCalibration(signed char calibration)
+{
+	unsigned char control = DS1340_SHADOW[CONTROL_REG] & ~(CAL_S_POS | CAL_MASK);
+
+	if(calibration < 0)
+		control |= CAL_S_NEG | ((unsigned char)(-calibration) & CAL_MASK);
+	else
+		control |= CAL_S_POS | ((unsigned char)calibration & CAL_MASK);
+	writeRegister(CONTROL_REG, control);
+}
+
+void setFrequencyTest(unsigned char enabled)
+{
+	unsigned char control = DS1340_SHADOW[CONTROL_REG] & ~FT_ON;
+
+	if(enabled)
+		control |= FT_ON;
+	writeRegister(CONTROL_REG, control);
 }
 
 unsigned char getOSF()
 {
-	// Read OSF
-	unsigned char READOSF, status;
-	//return 1;
-	StartI2C2();
-	WriteI2C2( ADDR | 0x00 );
-	WriteI2C2( OSF_REG );
-	StartI2C2();
-	WriteI2C2( ADDR | 0x01 );
-	READOSF = ReadI2C2();
-	NotAckI2C2();
-	StopI2C2();	
-	return (READOSF >> 7);
+	readRegisters(OSF_REG, 1);
+	return (DS1340_SHADOW[OSF_REG] >> 7);
 }
 
 void clearOSF()
 {
-	StartI2C2();
-	WriteI2C2( ADDR | 0x00 );
-	WriteI2C2( OSF_REG );
-	WriteI2C2( 0x00 );
-	StopI2C2();
+	// The DS1340 sets OSF on its own, so the shadow can't be trusted here.
+	DS1340_SHADOW[OSF_REG] = 0x00;
+	rtcWriteRegisters(ADDR, OSF_REG, DS1340_SHADOW + OSF_REG, 1);
 }
 
-static unsigned char convert2bcd(unsigned char data)
+// Burst read count registers, starting at first, into the shadow.
+static void readRegisters(unsigned char first, unsigned char count)
 {
-	return((data / 10 << 4) + (data % 10));
+	rtcReadRegisters(ADDR, first, DS1340_SHADOW + first, count);
 }
 
-static unsigned char convert2char(unsigned char bcd)
+// Write one register, unless the shadow says it already holds value.
+static void writeRegister(unsigned char reg, unsigned char value)
 {
-	//      UPPER BIT	 LOWER BIT
-	return((bcd/16)*10 + (bcd%16));
-}
\ No newline at end of file
+	if(DS1340_SHADOW[reg] == value)
+		return;
+
+	DS1340_SHADOW[reg] = value;
+	rtcWriteRegisters(ADDR, reg, DS1340_SHADOW + reg, 1);
+}
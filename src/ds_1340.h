@@ -1,17 +1,31 @@
 /** @file ds_1340.h
-* Contains functions for controlling the DS1340 RTC. 
+* Contains functions for controlling the DS1340 RTC.
+*
+* The driver keeps a shadow copy of all ten DS1340 registers. The control and trickle charger registers are only
+* ever changed by this driver, so writes to them are skipped when the shadow already holds the requested value.
+* The time and flag registers are changed by the DS1340 itself, so writes to those always go out on the bus.
 */
 
 #ifndef DS_1340_H
 #define DS_1340_H
 
-//! @name Addresses of the control registers.
+//! @name Addresses of the DS1340 registers.
 //!@{
-#define TRICKLE_REG 0x08
+#define SECONDS_REG	0x00
+#define MINUTES_REG	0x01
+#define HOURS_REG	0x02
+#define DAY_REG		0x03
+#define DATE_REG	0x04
+#define MONTH_REG	0x05
+#define YEAR_REG	0x06
 #define CONTROL_REG 0x07
+#define TRICKLE_REG 0x08
 #define OSF_REG		0x09
 //!@}
 
+//! The number of registers in the DS1340 register map.
+#define DS1340_REGISTERS	10
+
 //! @name Time Masks
 //! Masks used to ensure that info shared in the same registers as
 //! the hours, seconds, and minutes does not effect their values.
@@ -21,6 +35,14 @@
 #define HOURS_MASK		0b00111111
 //!@}
 
+//! @name Flag bits shared with the time and flag registers.
+//!@{
+#define EOSC_BIT	0x80		//!< Seconds register. Set to stop the oscillator.
+#define CEB_BIT		0x80		//!< Hours register. Century enable.
+#define CB_BIT		0x40		//!< Hours register. Century bit.
+#define OSF_BIT		0x80		//!< Flag register. Set when the oscillator has stopped.
+//!@}
+
 //! The DS1340 I2C Address
 #define ADDR 0b11010000
 
@@ -47,12 +69,13 @@
 #define FT_OFF		0x00
 #define CAL_S_POS	0x20
 #define CAL_S_NEG	0x00
+#define CAL_MASK	0x1F
 //@}
 
 /**
- 
+
 * A structure that contains all of the DS1340 information.
- 
+
 * This data structure is used in communicating with the DS1340 real time clock.
 */
 typedef struct
@@ -63,34 +86,57 @@ typedef struct
 	unsigned char trickle_reg;	//!< Contains the trickle charger control register (0x08) information.
 	unsigned char control_reg;	//!< Contains the control register (0x07) information.
 	unsigned char OSF;		//!< Contains the OSF register flag.
-	
+	signed char calibration;	//!< The calibration from the control register, -31 to 31.
+	unsigned char FT;		//!< Set if the frequency test output is on.
+
 } DS_1340;
 
 /**
 * Initializes the DS1340 using the config variable specified.
+* All ten registers are read into the shadow in one burst, and the control and
+* trickle charger registers are only written if they differ from config.
 	@param config Pointer to the DS_1340 structure containing the desired configuration.
 */
 void initializeDS1340(DS_1340 *config);
 
 /**
-* Writes the DS1340 hours, minutes, and seconds registers from a DS_1340 structure. 
+* Writes the DS1340 hours, minutes, and seconds registers from a DS_1340 structure.
 	@param data_out Pointer to the DS_1340 structure containing the time to be written to the DS1340.
 */
 void writeDS1340(DS_1340 *data_out);
 
 /**
-* Reads the DS1340 hours, minutes, and seconds into a DS_1340 structure. 
+* Reads the DS1340 hours, minutes, and seconds into a DS_1340 structure.
 	@param data_in Pointer to the DS_1340 structure that will contain the DS1340 information.
 */
 void readDS1340(DS_1340 *data_in);
 
 /**
-* Reads the DS1340 trickle charger, control register, and OSF into a DS_1340 structure. 
+* Reads the DS1340 trickle charger, control register, and OSF into a DS_1340 structure.
+* The calibration and FT fields are decoded from the control register.
 	@param data_in Pointer to the DS_1340 structure that will contain the DS1340 information.
 */
 void readControls(DS_1340 *data_in);
 
+/**
+* Sets the oscillator calibration. Nothing is written if the calibration is unchanged.
+	@param calibration The calibration, -31 (slow down) to 31 (speed up).
+*/
+void setCalibration(signed char calibration);
+
+/**
+* Turns the frequency test output on or off. Nothing is written if it is unchanged.
+	@param enabled Non-zero to turn the frequency test output on.
+*/
+void setFrequencyTest(unsigned char enabled);
+
+/**
+* Reads the OSF flag of the DS1340.
+	@return Returns 1 if the oscillator has stopped since the flag was last cleared.
+*/
+unsigned char getOSF(void);
+
 /// Clears the OSF flag of the DS1340.
 void clearOSF(void);
 
-#endif
\ No newline at end of file
+#endif
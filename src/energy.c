@@ -0,0 +1,111 @@
+#include "energy.h"
+#include "clock_lib.h"
+#include "osc_config.h"
+
+extern const unsigned char GAMMA_TABLE_H[128];
+extern const unsigned char GAMMA_TABLE_L[128];
+
+static unsigned int onCounts(unsigned char brightness);
+static unsigned char litLEDs(unsigned char *frame);
+
+// One LED per letter on the stock face. Change these to match the build.
+const unsigned char LED_COUNTS[32] =
+{
+0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+6,		// MINUTES_OCLOCK
+3,		// HOUR_TEN
+6,		// HOUR_TWELVE
+5,		// HOUR_SEVEN
+6,		// HOUR_ELEVEN
+5,		// HOUR_EIGHT
+3,		// HOUR_TWO
+4,		// HOUR_FIVE
+4,		// HOUR_FOUR
+5,		// HOUR_THREE
+3,		// HOUR_SIX
+3,		// HOUR_ONE
+4,		// HOUR_NINE
+4,		// CONSTRUCTORS_PAST
+2,		// CONSTRUCTORS_OF
+3,		// MINUTES_TEN
+4,		// MINUTES_HALF
+4,		// MINUTES_FIVE
+6,		// MINUTES_TWENTY
+7,		// MINUTES_QUARTER
+1,		// CONSTRUCTORS_A
+4		// IT_IS
+};
+
+//! Energy used by each word, in LED-timer counts.
+static unsigned long WORD_ENERGY[32];
+
+void initializeEnergy(void)
+{
+	unsigned char i;
+
+	for(i = 0; i < 32; i++)
+		WORD_ENERGY[i] = 0;
+}
+
+void energyAccount(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *FADING_MARKS,
+				   unsigned char on_brightness, unsigned char fade_brightness, unsigned char periods)
+{
+	unsigned int on_counts = onCounts(on_brightness);
+	unsigned int fade_counts = onCounts(fade_brightness);
+	unsigned char i, j, LED_NO;
+
+	// CCP1 cuts everything off, so a fading LED can never be on for longer than the rest.
+	if(fade_counts > on_counts)
+		fade_counts = on_counts;
+
+	LED_NO = 0;
+	for(i = 0; i < 4; i++)
+	{
+		for(j = 0; j < 8; j++, LED_NO++)
+		{
+			if(!((SHIFT_REGISTER_OUTPUTS[i] >> j) & 0x01))
+				continue;
+			if((FADING_MARKS[i] >> j) & 0x01)
+				WORD_ENERGY[LED_NO] += (unsigned long)LED_COUNTS[LED_NO] * on_counts * periods;
+			else
+				WORD_ENERGY[LED_NO] += (unsigned long)LED_COUNTS[LED_NO] * fade_counts * periods;
+		}
+	}
+}
+
+unsigned long getEnergy(unsigned char LED_NO)
+{
+	return WORD_ENERGY[LED_NO];
+}
+
+unsigned char energyLimit(unsigned char *frame, unsigned char brightness)
+{
+	unsigned long load_per_count = (unsigned long)litLEDs(frame) * LED_CURRENT_MA;
+	unsigned long budget = (unsigned long)CURRENT_CEILING_MA * T1_PERIOD;
+
+	// Average current is LEDs * LED current * duty cycle. Step down until it fits.
+	while(brightness > 2 && load_per_count * onCounts(brightness) > budget)
+		brightness--;
+	return brightness;
+}
+
+// The number of timer counts the LEDs stay lit for at a brightness.
+static unsigned int onCounts(unsigned char brightness)
+{
+	unsigned int compare = ((unsigned int)GAMMA_TABLE_H[brightness] << 8) | GAMMA_TABLE_L[brightness];
+	return compare - T1_RELOAD;
+}
+
+// The total number of LEDs lit by a frame.
+static unsigned char litLEDs(unsigned char *frame)
+{
+	unsigned char i, j, LED_NO, total;
+
+	total = 0;
+	LED_NO = 0;
+	for(i = 0; i < 4; i++)
+		for(j = 0; j < 8; j++, LED_NO++)
+			if((frame[i] >> j) & 0x01)
+				total += LED_COUNTS[LED_NO];
+	return total;
+}
@@ -0,0 +1,54 @@
+/**
+@file energy.h
+@brief Keeps a running total of the energy used by each word, and limits the brightness to a current budget.
+
+Each shift register output lights a different number of LEDs. How long it is lit each period depends on the compare
+value it is cut off by: CCP1 for the universal brightness, or CCP2 for the LEDs being faded. Energy is counted in
+LED-timer counts, that is one LED lit for one timer 1 count. Multiply by LED_CURRENT_MA and divide by the timer 1
+count rate to get mA-seconds.
+*/
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+//!@name Current budget.
+//!@{
+#define LED_CURRENT_MA		20		//!< The current through one fully lit LED.
+#define CURRENT_CEILING_MA	400		//!< The largest average current the face may draw over a PWM period.
+//!@}
+
+//! The number of LEDs behind each shift register output, by LED position (see clock_lib.h).
+extern const unsigned char LED_COUNTS[32];
+
+/**
+@brief Zeroes every word's total. Called once from main(), as the startup code leaves the totals uninitialised.
+*/
+void initializeEnergy(void);
+
+/**
+@brief Adds the energy used over a number of PWM periods to each word's total.
+@param SHIFT_REGISTER_OUTPUTS	Points to the main array of 4 unsigned chars containing which LEDs are on.
+@param FADING_MARKS		Points to the array of 4 unsigned chars marking (with a 0) the LEDs cut off by CCP2.
+@param on_brightness	The universal brightness, 0-127, that cuts off every other LED.
+@param fade_brightness	The fading brightness, 0-127, or the universal brightness if nothing is fading.
+@param periods			The number of PWM periods to account for.
+*/
+void energyAccount(unsigned char *SHIFT_REGISTER_OUTPUTS, unsigned char *FADING_MARKS,
+				   unsigned char on_brightness, unsigned char fade_brightness, unsigned char periods);
+
+/**
+@brief Gets the energy a word has used since power up.
+@param LED_NO	The position of the word, 0-31.
+@return Returns the total in LED-timer counts.
+*/
+unsigned long getEnergy(unsigned char LED_NO);
+
+/**
+@brief Clamps a brightness so that the given LEDs stay inside CURRENT_CEILING_MA.
+@param frame		Points to an array of 4 unsigned chars containing the LEDs that will be lit.
+@param brightness	The requested brightness, 2-127.
+@return Returns the highest brightness, no greater than the one requested and no lower than 2, that fits the budget.
+*/
+unsigned char energyLimit(unsigned char *frame, unsigned char brightness);
+
+#endif
@@ -5,271 +5,274 @@
 
 @brief Contains the comparitor values to achieve a more linear color profile of the LEDs.
 
+The entries are worked out at compile time from the timer 1 period in osc_config.h, so they follow F_OSC.
+
 Made using the Maxim APP Note "Using Lookup Tables to Perform Gamma Correction on LEDs."
 www.maxim-ic.com/app-notes/index.mvp/id/3667
 */
 
+#include "osc_config.h"
+
 const unsigned char GAMMA_TABLE_H[128] = 
 { 
-0x63,
-0x63,
-0x63,
-0x63,
-0x63,
-0x63,
-0x64,
-0x64,
-0x64,
-0x64,
-0x64,
-0x64,
-0x65,
-0x65,
-0x65,
-0x65,
-0x66,
-0x66,
-0x66,
-0x67,
-0x67,
-0x67,
-0x68,
-0x68,
-0x69,
-0x69,
-0x6A,
-0x6A,
-0x6B,
-0x6B,
-0x6C,
-0x6C,
-0x6D,
-0x6E,
-0x6E,
-0x6F,
-0x70,
-0x70,
-0x71,
-0x72,
-0x73,
-0x73,
-0x74,
-0x75,
-0x76,
-0x77,
-0x77,
-0x78,
-0x79,
-0x7A,
-0x7B,
-0x7C,
-0x7D,
-0x7E,
-0x7F,
-0x80,
-0x81,
-0x82,
-0x83,
-0x84,
-0x86,
-0x87,
-0x88,
-0x89,
-0x8A,
-0x8C,
-0x8D,
-0x8E,
-0x8F,
-0x91,
-0x92,
-0x93,
-0x95,
-0x96,
-0x97,
-0x99,
-0x9A,
-0x9C,
-0x9D,
-0x9F,
-0xA0,
-0xA2,
-0xA3,
-0xA5,
-0xA7,
-0xA8,
-0xAA,
-0xAB,
-0xAD,
-0xAF,
-0xB0,
-0xB2,
-0xB4,
-0xB6,
-0xB8,
-0xB9,
-0xBB,
-0xBD,
-0xBF,
-0xC1,
-0xC3,
-0xC5,
-0xC6,
-0xC8,
-0xCA,
-0xCC,
-0xCE,
-0xD0,
-0xD2,
-0xD5,
-0xD7,
-0xD9,
-0xDB,
-0xDD,
-0xDF,
-0xE1,
-0xE4,
-0xE6,
-0xE8,
-0xEA,
-0xED,
-0xEF,
-0xF1,
-0xF4,
-0xF6,
-0xF8,
-0xFB,
-0xFD
+GAMMA_H(0),
+GAMMA_H(1),
+GAMMA_H(2),
+GAMMA_H(3),
+GAMMA_H(4),
+GAMMA_H(5),
+GAMMA_H(6),
+GAMMA_H(7),
+GAMMA_H(8),
+GAMMA_H(9),
+GAMMA_H(10),
+GAMMA_H(11),
+GAMMA_H(12),
+GAMMA_H(13),
+GAMMA_H(14),
+GAMMA_H(15),
+GAMMA_H(16),
+GAMMA_H(17),
+GAMMA_H(18),
+GAMMA_H(19),
+GAMMA_H(20),
+GAMMA_H(21),
+GAMMA_H(22),
+GAMMA_H(23),
+GAMMA_H(24),
+GAMMA_H(25),
+GAMMA_H(26),
+GAMMA_H(27),
+GAMMA_H(28),
+GAMMA_H(29),
+GAMMA_H(30),
+GAMMA_H(31),
+GAMMA_H(32),
+GAMMA_H(33),
+GAMMA_H(34),
+GAMMA_H(35),
+GAMMA_H(36),
+GAMMA_H(37),
+GAMMA_H(38),
+GAMMA_H(39),
+GAMMA_H(40),
+GAMMA_H(41),
+GAMMA_H(42),
+GAMMA_H(43),
+GAMMA_H(44),
+GAMMA_H(45),
+GAMMA_H(46),
+GAMMA_H(47),
+GAMMA_H(48),
+GAMMA_H(49),
+GAMMA_H(50),
+GAMMA_H(51),
+GAMMA_H(52),
+GAMMA_H(53),
+GAMMA_H(54),
+GAMMA_H(55),
+GAMMA_H(56),
+GAMMA_H(57),
+GAMMA_H(58),
+GAMMA_H(59),
+GAMMA_H(60),
+GAMMA_H(61),
+GAMMA_H(62),
+GAMMA_H(63),
+GAMMA_H(64),
+GAMMA_H(65),
+GAMMA_H(66),
+GAMMA_H(67),
+GAMMA_H(68),
+GAMMA_H(69),
+GAMMA_H(70),
+GAMMA_H(71),
+GAMMA_H(72),
+GAMMA_H(73),
+GAMMA_H(74),
+GAMMA_H(75),
+GAMMA_H(76),
+GAMMA_H(77),
+GAMMA_H(78),
+GAMMA_H(79),
+GAMMA_H(80),
+GAMMA_H(81),
+GAMMA_H(82),
+GAMMA_H(83),
+GAMMA_H(84),
+GAMMA_H(85),
+GAMMA_H(86),
+GAMMA_H(87),
+GAMMA_H(88),
+GAMMA_H(89),
+GAMMA_H(90),
+GAMMA_H(91),
+GAMMA_H(92),
+GAMMA_H(93),
+GAMMA_H(94),
+GAMMA_H(95),
+GAMMA_H(96),
+GAMMA_H(97),
+GAMMA_H(98),
+GAMMA_H(99),
+GAMMA_H(100),
+GAMMA_H(101),
+GAMMA_H(102),
+GAMMA_H(103),
+GAMMA_H(104),
+GAMMA_H(105),
+GAMMA_H(106),
+GAMMA_H(107),
+GAMMA_H(108),
+GAMMA_H(109),
+GAMMA_H(110),
+GAMMA_H(111),
+GAMMA_H(112),
+GAMMA_H(113),
+GAMMA_H(114),
+GAMMA_H(115),
+GAMMA_H(116),
+GAMMA_H(117),
+GAMMA_H(118),
+GAMMA_H(119),
+GAMMA_H(120),
+GAMMA_H(121),
+GAMMA_H(122),
+GAMMA_H(123),
+GAMMA_H(124),
+GAMMA_H(125),
+GAMMA_H(126),
+GAMMA_H(127)
 };
 
 const unsigned char GAMMA_TABLE_L[128] = 
 {
-//LO
-0xBF,
-0xC2,
-0xC9,
-0xD5,
-0xE7,
-0xFD,
-0x17,
-0x37,
-0x5C,
-0x85,
-0xB4,
-0xE7,
-0x1F,
-0x5C,
-0x9E,
-0xE5,
-0x30,
-0x81,
-0xD7,
-0x31,
-0x90,
-0xF4,
-0x5D,
-0xCB,
-0x3E,
-0xB5,
-0x32,
-0xB3,
-0x3A,
-0xC5,
-0x55,
-0xEA,
-0x83,
-0x22,
-0xC6,
-0x6E,
-0x1C,
-0xCE,
-0x85,
-0x41,
-0x02,
-0xC8,
-0x92,
-0x62,
-0x36,
-0x0F,
-0xEE,
-0xD1,
-0xB8,
-0xA5,
-0x97,
-0x8E,
-0x89,
-0x89,
-0x8F,
-0x99,
-0xA8,
-0xBC,
-0xD4,
-0xF2,
-0x15,
-0x3C,
-0x68,
-0x99,
-0xCF,
-0x0A,
-0x4A,
-0x8F,
-0xD9,
-0x27,
-0x7A,
-0xD3,
-0x30,
-0x92,
-0xF9,
-0x64,
-0xD5,
-0x4B,
-0xC5,
-0x44,
-0xC8,
-0x52,
-0xE0,
-0x72,
-0x0A,
-0xA7,
-0x48,
-0xEF,
-0x9A,
-0x4A,
-0xFF,
-0xB9,
-0x78,
-0x3B,
-0x04,
-0xD1,
-0xA3,
-0x7B,
-0x57,
-0x38,
-0x1E,
-0x08,
-0xF8,
-0xEC,
-0xE6,
-0xE4,
-0xE7,
-0xEF,
-0xFC,
-0x0E,
-0x25,
-0x40,
-0x60,
-0x86,
-0xB0,
-0xDF,
-0x13,
-0x4C,
-0x8A,
-0xCC,
-0x14,
-0x60,
-0xB1,
-0x08,
-0x63,
-0xC2,
-0x27,
-0x91
+GAMMA_L(0),
+GAMMA_L(1),
+GAMMA_L(2),
+GAMMA_L(3),
+GAMMA_L(4),
+GAMMA_L(5),
+GAMMA_L(6),
+GAMMA_L(7),
+GAMMA_L(8),
+GAMMA_L(9),
+GAMMA_L(10),
+GAMMA_L(11),
+GAMMA_L(12),
+GAMMA_L(13),
+GAMMA_L(14),
+GAMMA_L(15),
+GAMMA_L(16),
+GAMMA_L(17),
+GAMMA_L(18),
+GAMMA_L(19),
+GAMMA_L(20),
+GAMMA_L(21),
+GAMMA_L(22),
+GAMMA_L(23),
+GAMMA_L(24),
+GAMMA_L(25),
+GAMMA_L(26),
+GAMMA_L(27),
+GAMMA_L(28),
+GAMMA_L(29),
+GAMMA_L(30),
+GAMMA_L(31),
+GAMMA_L(32),
+GAMMA_L(33),
+GAMMA_L(34),
+GAMMA_L(35),
+GAMMA_L(36),
+GAMMA_L(37),
+GAMMA_L(38),
+GAMMA_L(39),
+GAMMA_L(40),
+GAMMA_L(41),
+GAMMA_L(42),
+GAMMA_L(43),
+GAMMA_L(44),
+GAMMA_L(45),
+GAMMA_L(46),
+GAMMA_L(47),
+GAMMA_L(48),
+GAMMA_L(49),
+GAMMA_L(50),
+GAMMA_L(51),
+GAMMA_L(52),
+GAMMA_L(53),
+GAMMA_L(54),
+GAMMA_L(55),
+GAMMA_L(56),
+GAMMA_L(57),
+GAMMA_L(58),
+GAMMA_L(59),
+GAMMA_L(60),
+GAMMA_L(61),
+GAMMA_L(62),
+GAMMA_L(63),
+GAMMA_L(64),
+GAMMA_L(65),
+GAMMA_L(66),
+GAMMA_L(67),
+GAMMA_L(68),
+GAMMA_L(69),
+GAMMA_L(70),
+GAMMA_L(71),
+GAMMA_L(72),
+GAMMA_L(73),
+GAMMA_L(74),
+GAMMA_L(75),
+GAMMA_L(76),
+GAMMA_L(77),
+GAMMA_L(78),
+GAMMA_L(79),
+GAMMA_L(80),
+GAMMA_L(81),
+GAMMA_L(82),
+GAMMA_L(83),
+GAMMA_L(84),
+GAMMA_L(85),
+GAMMA_L(86),
+GAMMA_L(87),
+GAMMA_L(88),
+GAMMA_L(89),
+GAMMA_L(90),
+GAMMA_L(91),
+GAMMA_L(92),
+GAMMA_L(93),
+GAMMA_L(94),
+GAMMA_L(95),
+GAMMA_L(96),
+GAMMA_L(97),
+GAMMA_L(98),
+GAMMA_L(99),
+GAMMA_L(100),
+GAMMA_L(101),
+GAMMA_L(102),
+GAMMA_L(103),
+GAMMA_L(104),
+GAMMA_L(105),
+GAMMA_L(106),
+GAMMA_L(107),
+GAMMA_L(108),
+GAMMA_L(109),
+GAMMA_L(110),
+GAMMA_L(111),
+GAMMA_L(112),
+GAMMA_L(113),
+GAMMA_L(114),
+GAMMA_L(115),
+GAMMA_L(116),
+GAMMA_L(117),
+GAMMA_L(118),
+GAMMA_L(119),
+GAMMA_L(120),
+GAMMA_L(121),
+GAMMA_L(122),
+GAMMA_L(123),
+GAMMA_L(124),
+GAMMA_L(125),
+GAMMA_L(126),
+GAMMA_L(127)
 };
\ No newline at end of file
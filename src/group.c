@@ -0,0 +1,77 @@
+#include <p18f26k22.h>
+#include "group.h"
+#include "clock_lib.h"
+
+const extern unsigned char GAMMA_TABLE_H[128];
+const extern unsigned char GAMMA_TABLE_L[128];
+
+unsigned char GROUP_KEEP[GROUP_COUNT][4];
+
+volatile unsigned char GROUP_PENDING;
+
+//! The compare values and modes waiting for groupCommit.
+static unsigned char GROUP_STAGED_H[GROUP_COUNT];
+static unsigned char GROUP_STAGED_L[GROUP_COUNT];
+static unsigned char GROUP_STAGED_MODE[GROUP_COUNT];
+
+void initializeGroups(void)
+{
+	unsigned char g, i;
+
+	for(g = 0; g < GROUP_COUNT; g++)
+	{
+		for(i = 0; i < 4; i++)
+			GROUP_KEEP[g][i] = 0xFF;
+		groupLevel(g, GROUP_OFF);
+	}
+
+	// Compare on timer 1, at high priority like CCP1 and CCP2.
+	CCPTMRS1 = 0;
+	IPR4bits.CCP3IP = 1;
+	IPR4bits.CCP4IP = 1;
+	IPR4bits.CCP5IP = 1;
+	PIE4bits.CCP4IE = 1;
+	PIE4bits.CCP5IE = 1;
+	#ifndef OE_PWM
+	PIE4bits.CCP3IE = 1;
+	#endif
+}
+
+void groupAssign(unsigned char group, unsigned char LED_NO, unsigned char in)
+{
+	// The keep mask is inverted: an LED in the group is a clear bit.
+	if(in)
+		clearArray(GROUP_KEEP[group], LED_NO);
+	else
+		setArray(GROUP_KEEP[group], LED_NO);
+}
+
+void groupLevel(unsigned char group, unsigned char index)
+{
+	if(index == GROUP_OFF)
+	{
+		GROUP_STAGED_MODE[group] = 0x00;
+		index = 0;
+	} else {
+		GROUP_STAGED_MODE[group] = 0x0A;
+	}
+	GROUP_STAGED_H[group] = GAMMA_TABLE_H[index];
+	GROUP_STAGED_L[group] = GAMMA_TABLE_L[index];
+	GROUP_PENDING = 1;
+}
+
+void groupCommit(void)
+{
+	#ifndef OE_PWM
+	CCPR3H = GROUP_STAGED_H[0];
+	CCPR3L = GROUP_STAGED_L[0];
+	CCP3CON = GROUP_STAGED_MODE[0];
+	#endif
+	CCPR4H = GROUP_STAGED_H[1];
+	CCPR4L = GROUP_STAGED_L[1];
+	CCP4CON = GROUP_STAGED_MODE[1];
+	CCPR5H = GROUP_STAGED_H[2];
+	CCPR5L = GROUP_STAGED_L[2];
+	CCP5CON = GROUP_STAGED_MODE[2];
+	GROUP_PENDING = 0;
+}
@@ -0,0 +1,60 @@
+/**
+@file group.h
+@brief Brightness groups: sets of LEDs cut early in the period, each by its own compare channel.
+
+CCP1 cuts every LED at the universal brightness and CCP2 cuts the fading LEDs. CCP3 to CCP5 are otherwise idle, so
+each one cuts a group of LEDs at its own gamma index, on the same timer 1 period. For example, the long words can be
+trimmed to match the short ones. Each group keeps the inverse of its LED mask, so when its edge arrives the
+high priority interrupt only ANDs four bytes into the live mask before it writes the frame back out. An LED in a group
+is lit for the shorter of the universal brightness and the group brightness.
+
+With OE_PWM, CCP3 drives the OE line and group 0 is not available.
+*/
+
+#ifndef GROUP_H
+#define GROUP_H
+
+//! The number of groups, one each for CCP3, CCP4 and CCP5.
+#define GROUP_COUNT		3
+
+//! Passed to groupLevel to turn a group's compare channel off.
+#define GROUP_OFF		0xFF
+
+/**
+The LEDs each group leaves lit at its edge, as the inverse of its LED mask.
+Read by the high priority interrupt, so change it with the interrupt held off.
+*/
+extern unsigned char GROUP_KEEP[GROUP_COUNT][4];
+
+//! Set by groupLevel when there are compare values waiting for groupCommit.
+extern volatile unsigned char GROUP_PENDING;
+
+/**
+@brief Empties every group and turns CCP3 to CCP5 off.
+*/
+void initializeGroups(void);
+
+/**
+@brief Adds an LED to a group or takes it out. Call with the high priority interrupt held off.
+@param group	The group, 0 to GROUP_COUNT - 1.
+@param LED_NO	The LED position, as in clock_lib.h.
+@param in		Non-zero to add the LED, zero to take it out.
+*/
+void groupAssign(unsigned char group, unsigned char LED_NO, unsigned char in);
+
+/**
+@brief Sets the brightness of a group. Call with the high priority interrupt held off.
+@param group	The group, 0 to GROUP_COUNT - 1.
+@param index	A gamma index, 0-127, or GROUP_OFF.
+
+The new compare value is only staged here. groupCommit writes it at the start of the next period.
+*/
+void groupLevel(unsigned char group, unsigned char index);
+
+/**
+@brief Writes the staged compare values to CCP3 to CCP5.
+Called by the timer 1 interrupt when GROUP_PENDING is set, while timer 1 is well clear of every compare value.
+*/
+void groupCommit(void);
+
+#endif
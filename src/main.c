@@ -6,39 +6,95 @@
 
 Define LIGHTTEST to run a modified version that turns on all of the lights.
 Define LIGHTTEST_IND to run a modified version that goes through each inidividual light.
+Define PROFILE to mark the hot paths on port A for timing (see profile.h).
+Define TIMEKEEPER to pick the clock source (see timekeeper.h).
 */
 
 #include <p18f26k22.h>
 #include <delays.h>
 #include <i2c.h>
-#include "ds_1340.h"
+#include "timekeeper.h"
 #include "clock_lib.h"
+#include "schedule.h"
+#include "energy.h"
+#include "osc_config.h"
+#include "dither.h"
+#include "transition.h"
+#include "profile.h"
+#include "power.h"
+#include "group.h"
+#include "snapshot.h"
+#include "compositor.h"
 
 //#define LIGHTTEST
 //#define LIGHTTEST_IND
 
 void InterruptHandlerHigh(void);
+void InterruptHandlerLow(void);
 void writeShifts(unsigned char data[], unsigned char length);
+void stageShifts(unsigned char data[], unsigned char length);
+void latchShifts(void);
+void blankShifts(void);
+void cutFading(void);
+void cutGroups(void);
+void powerUpdate(void);
 void timeIncrease(void);
 void timeDecrease(void);
+void scheduledAction(unsigned char action, unsigned char arg);
+void scheduleCatchUp(unsigned char brightness);
+void applyBrightness(void);
+void showTime(unsigned char kind);
+void presentDisplay(unsigned char kind);
+void startCalibration(void);
+void calibrationTick(unsigned char periods);
 
 //! @name	Compiler config options.
 //!@{
 #pragma config FOSC = INTIO67
 #pragma config HFOFST = ON
 #pragma config WDTEN = OFF
-#pragma config PLLCFG = ON
+#pragma config PLLCFG = OFF		// The PLL is turned on and off by OSCTUNEbits.PLLEN, see power.h
 #pragma config PWRTEN = ON
+#ifdef OE_PWM
+#pragma config CCP3MX = PORTC6		// P3A drives the shift register OE line
+#endif
+//!@}
+
+//!@name	Shift register pins.
+//!@brief	The port C bits wired to the shift register chain. Each can be overridden for a board wired differently.
+//!TIMEKEEPER_SOSC needs RC0 and RC1 for the crystal, so SH moves to RC5 in that build by default.
+//!@{
+#ifndef DS_BIT
+#define DS_BIT				3
+#endif
+#ifndef ST_BIT
+#define ST_BIT				2
+#endif
+#ifndef SH_BIT
+#if TIMEKEEPER == TIMEKEEPER_SOSC
+#define SH_BIT				5
+#else
+#define SH_BIT				1
+#endif
+#endif
+#define PORTC_LAT(bit)		PORTC_LAT_(bit)			//!< Expands bit before pasting it on.
+#define PORTC_LAT_(bit)		LATCbits.LATC##bit
+#define PORTC_TRIS(bit)		PORTC_TRIS_(bit)
+#define PORTC_TRIS_(bit)	TRISCbits.TRISC##bit
+#if TIMEKEEPER == TIMEKEEPER_SOSC && (DS_BIT < 2 || ST_BIT < 2 || SH_BIT < 2)
+	#error "RC0 and RC1 carry the SOSC crystal, so the shift register can't use them with TIMEKEEPER_SOSC."
+#endif
 //!@}
 
 //!@name	Tristate and latch macros.
 //!@{
-#define ds LATCbits.LATC3						//!< Shift register DS Output
-#define st LATCbits.LATC2						//!< Shift register ST Output
-#define sh LATCbits.LATC1						//!< Shift register SH Output
-#define ds_tris TRISCbits.TRISC3				//!< Shift register DS TRIS
-#define st_tris TRISCbits.TRISC2				//!< Shift register ST TRIS
-#define sh_tris TRISCbits.TRISC1				//!< Shift register SH TRIS
+#define ds PORTC_LAT(DS_BIT)					//!< Shift register DS Output
+#define st PORTC_LAT(ST_BIT)					//!< Shift register ST Output
+#define sh PORTC_LAT(SH_BIT)					//!< Shift register SH Output
+#define ds_tris PORTC_TRIS(DS_BIT)				//!< Shift register DS TRIS
+#define st_tris PORTC_TRIS(ST_BIT)				//!< Shift register ST TRIS
+#define sh_tris PORTC_TRIS(SH_BIT)				//!< Shift register SH TRIS
+#define oe_tris TRISCbits.TRISC6				//!< Shift register OE TRIS, only driven when OE_PWM is defined
 #define brightness_up_tris TRISBbits.TRISB0		//!< Brightness Button Up TRIS
 #define brightness_down_tris TRISBbits.TRISB3	//!< Brightness Button Down TRIS
 #define time_up_tris TRISBbits.TRISB4			//!< Time Increment Button TRIS
@@ -49,54 +105,180 @@ void timeDecrease(void);
 #define time_down PORTBbits.RB5					//!< Time Decrement Button Input
 //!@}
 
+//!@name	Output enable.
+//!@brief	Define OE_PWM on a board with the shift register OE line wired to RC6. ECCP3 then blanks the whole chain
+//!in hardware for the global brightness, and CCP1 and its interrupt are not used. The fades still cut the fading
+//!LEDs with CCP2, as a share of the OE duty, so they run over the whole gamma table.
+//!@{
+#ifdef OE_PWM
+#define FADE_CEILING		BRIGHTNESS_LEVEL(127, 0)
+#else
+#define FADE_CEILING		UNIVERSAL_LEVEL
+#endif
+//!@}
+
+//!@name	Deep dim.
+//!@brief	Below this gamma index, the CCP1 edge comes before the timer 1 interrupt can return and CCP1 be entered,
+//!so the edge would be served late and every level down there would look the same. Timer 1 waits for the edge
+//!itself and blanks the chain with blankShifts instead. Not used with OE_PWM, which has no such floor.
+//!@{
+#define DEEP_DIM_INDEX		16
+//!@}
+
+//!@name	Schedule macros.
+//!@brief	The default times of day, 0-23, and brightnesses used by the scheduler.
+//!Define QUIET_HOURS to also turn the display off overnight.
+//!@{
+#define NIGHT_START_HOUR	22
+#define NIGHT_BRIGHTNESS	20
+#define DAY_START_HOUR		7
+#define DAY_BRIGHTNESS		120
+#define QUIET_START_HOUR	1
+#define QUIET_END_HOUR		6
+//!@}
+
+//!@name	Critical section macros.
+//!@brief	Hold off the interrupts while main() changes state that the interrupts also use.
+//!The previous GIEH is restored, so these may be used before the interrupts are turned on. Pairs must share a block.
+//!@{
+#define ENTER_CRITICAL()	{ unsigned char gie = INTCONbits.GIEH; INTCONbits.GIEH = 0;
+#define EXIT_CRITICAL()		INTCONbits.GIEH = gie; }
+//!@}
+
 //!@name	State machine macros.
 //!@{
 #define STANDARD_OP 0
 #define FADING_OUT	1
 #define FADING_IN	2
-#define TIME_CAL	3
-#define SEC_MSG		4
+//!@}
+
+//!@name	Interface modes.
+//!@brief	Either time button puts the clock into UI_TIME_CAL. The time words blink, everything but IT IS, until
+//!CAL_TIMEOUT_PERIODS pass without a press. The blink goes through the transition queue like any other display, so
+//!it waits for a running fade and never changes the frame under it.
+//!@{
+#define UI_CLOCK			0
+#define UI_TIME_CAL			1
+#define CAL_BLINK_PERIODS	50		//!< Half a blink, in PWM periods.
+#define CAL_TIMEOUT_PERIODS	500		//!< Idle periods before UI_TIME_CAL ends.
+//!@}
+
+//! True when two 4 byte frames light the same LEDs.
+#define SAME_FRAME(a, b)	((a)[0] == (b)[0] && (a)[1] == (b)[1] && (a)[2] == (b)[2] && (a)[3] == (b)[3])
+
+//!@name	Power macros.
+//!@brief	Run the core fast only while a transition is queued or fading. Used from the high priority interrupt, see power.h.
+//!@{
+#if POWER_SCALING
+//! Switches once the LEDs are blanked, in the dark gap before timer 1 overflows.
+#define POWER_UPDATE()		powerUpdate()
+//! Finishes or drops a switch up at the start of a period, before the relight.
+#define POWER_PERIOD()		powerPeriod()
+#else
+#define POWER_UPDATE()		do { } while(0)
+#define POWER_PERIOD()		do { } while(0)
+#endif
 //!@}
 
 /**
 @name Global Variables
 @{
 */
-//! The main program's DS1340 information.
-DS_1340 RTC;
+//! The time of day, as last set or handed out by the timekeeper.
+CLOCK_TIME RTC;
+
+//!@name Interrupt state.
+//!@brief Everything the interrupts touch each period, kept together in access RAM so none of it needs a bank switch.
+//!Access RAM can't be initialized by the startup code, so main() sets these up before the interrupts go on.
+//!@{
+#pragma udata access isr_state
 
 //! Master shift register output. Four unsigned chars, 1 for each shift register.
-unsigned char SHIFT_REGISTER_OUTPUTS[4] = {0x00, 0x00, 0x00, 0x00};
+near unsigned char SHIFT_REGISTER_OUTPUTS[4];
 
 //! Fading out variable. LEDs marked 0 will fade out, LEDs marked 1 will stay on.
-unsigned char FADING_MARKS[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+near unsigned char FADING_MARKS[4];
 
 //! Fading in variable. LEDs marked 1 will fade in, LEDs marked 0 will stay off.
-unsigned char INCOMING_LEDS[4] = {0x00, 0x00, 0x00, 0x00};
+near unsigned char INCOMING_LEDS[4];
 
-//! PWM Overall brightness, 1 - 127
-unsigned char UNIVERSAL_BRIGHTNESS = 120;
+//!@name Shift chain contents.
+//!@brief What the shift register outputs are showing, and what is sitting in the shift stage behind them.
+//!Kept by writeShifts, stageShifts, latchShifts and blankShifts, so timer 1 can tell how little it has to do.
+//!@{
+near unsigned char LATCHED_FRAME[4];
+near unsigned char STAGED_FRAME[4];
+//!@}
 
-//! The current fading brightness, if being used.
-unsigned char FADING_BRIGHTNESS;
+//! The LEDs not yet cut this period. Reset by timer 1 and ANDed down by each compare edge, so edges can come in any order.
+near unsigned char LIVE_MARKS[4];
+
+//! The compare values CCP1 is dithered between.
+near DITHER UNIVERSAL_DITHER;
+
+//! The compare values CCP2 is dithered between during a fade.
+near DITHER FADE_DITHER;
+
+//! The current fading level, if being used.
+near unsigned int FADING_LEVEL;
 
 //! The state machine variable. This begins in STANDARD_OP mode.
-unsigned char OP_MODE = STANDARD_OP;
+near volatile unsigned char OP_MODE;
+
+//! Counts timer 1 periods for the energy accounting. Cleared by main() once they are accounted for.
+near volatile unsigned char PWM_PERIODS;
+
+//! Flags shared with the interrupts. Each is set and cleared with a single BSF or BCF, so neither side needs a critical section for them.
+near volatile struct
+{
+	unsigned BTN_RDY:1;				//!< Set once a period to let the brightness buttons repeat.
+	unsigned DISPLAY_ENABLED:1;		//!< Cleared by the scheduler to blank the display. Timer 1 only relights the LEDs while this is set.
+	unsigned DEEP_DIM:1;			//!< Set while the universal level is below DEEP_DIM_INDEX.
+	unsigned POWER_FAIL:1;			//!< Set by the HLVD interrupt when it had to leave the sleep to main().
+	unsigned FAST_WANTED:1;			//!< Set by main() with each transitionPush, and cleared by the fade stepping once the queue is empty.
+} ISR_FLAGS;
+
+#pragma udata
+//!@}
+
+//! The display for the current time, as last queued for the fade engine.
+unsigned char DISPLAY_TARGET[4] = {0x00, 0x00, 0x00, 0x00};
 
-//! Hours: 0-11 (0 = 12, 1 = 1, ...)
+//! PWM Overall brightness, 1 - 127. This is BRIGHTNESS_SETTING, lowered if needed to stay in the current budget.
+unsigned char UNIVERSAL_BRIGHTNESS = 120;
+
+//! The brightness asked for by the buttons or the scheduler, 2 - 127.
+unsigned char BRIGHTNESS_SETTING = 120;
+
+//! Fine steps above BRIGHTNESS_SETTING, only used below DITHER_THRESHOLD.
+unsigned char BRIGHTNESS_FINE = 0;
+
+//! UNIVERSAL_BRIGHTNESS with its fine steps, as a dithered level. This is what the interrupt fades towards.
+unsigned int UNIVERSAL_LEVEL;
+
+//! Hours: 0-11 (0 = 12, 1 = 1, ...). RTC.hours keeps the full 0-23 hour.
 unsigned char HOURS;
 //! Minutes: 0-59.
 unsigned char MINUTES;
 
+//! UI_CLOCK or UI_TIME_CAL.
+unsigned char UI_MODE = UI_CLOCK;
+
+//!@name Time calibration variables.
+//!@{
+unsigned char CAL_PHASE;		//!< Periods into the current half blink.
+unsigned char CAL_HIDDEN;		//!< Set while the time words are blinked off.
+unsigned int CAL_IDLE;			//!< Periods since the last time button press.
+//!@}
+
 //!@name Button status variables. 
-//!@brief Used to ensure that buttons aren't triggered every execution of the main while loop.
+//!@brief Used to ensure that buttons aren't triggered every execution of the main while loop. See also ISR_FLAGS.BTN_RDY.
 //!@{
-unsigned char BTN_RDY;
 unsigned char BTN_DOWN_D, BTN_DOWN_U;
 //!@}
 
 //!@name Gamma table entries.
-//!@brief Gamma tables calculated for a 100Hz interrupt at 16MHz.
+//!@brief Gamma tables calculated for the timer 1 period derived in osc_config.h.
 //!@{
 const extern unsigned char GAMMA_TABLE_H[128];
 const extern unsigned char GAMMA_TABLE_L[128];
@@ -109,19 +291,22 @@ const extern unsigned char GAMMA_TABLE_L[128];
 //! The main function.
 void main()
 {
+	unsigned char warm, i;
 	#ifdef LIGHTTEST_IND
 	unsigned long *tester = SHIFT_REGISTER_OUTPUTS;
 	#endif
 
-	// Initialize Clock to 64MHz
-	OSCCONbits.IRCF = 0b111;
-	OSCTUNEbits.PLLEN = 1;
+	// Initialize Clock to F_OSC
+	OSCCONbits.IRCF = OSC_IRCF;
+	OSCTUNEbits.PLLEN = OSC_PLL;
 
 	// Turn off analog inputs. Zero port b.
 	ANSELC = 0;
 	ANSELB = 0;
 	ANSELA = 0;
 	PORTB = 0;
+	PROFILE_INIT();
+	PROFILE_BEGIN(PROFILE_BOOT);
 
 	// Set shift registers as outputs
 	st_tris = 0;
@@ -158,15 +343,15 @@ void main()
 			*tester = 0x80000000;	
 		writeShifts(SHIFT_REGISTER_OUTPUTS, 4);
 		
-		Delay10KTCYx(0);
-		Delay10KTCYx(0);
-		Delay10KTCYx(0);
-		Delay10KTCYx(0);	
+		Delay10KTCYx(DELAY_10KTCY(150));
+		Delay10KTCYx(DELAY_10KTCY(150));
+		Delay10KTCYx(DELAY_10KTCY(150));
+		Delay10KTCYx(DELAY_10KTCY(150));
 	}
 	#endif	
 
 	// Set initial conditions for the button handling variables.
-	BTN_RDY = 1;
+	ISR_FLAGS.BTN_RDY = 1;
 	BTN_DOWN_U = 0;
 	BTN_DOWN_D = 0;
 
@@ -175,84 +360,154 @@ void main()
 	PIE1bits.TMR1IE = 1;		  //enable TMR1 interrupt
 	IPR1bits.TMR1IP = 1;		  //enable TMR1 HP
   	RCONbits.IPEN = 1;            //enable priority levels
-  	T1CON = 0b00100111;           //set up timer1 - prescaler 1:4 - 100 Hz		- Enabled to start
-	T0CON = 0b10000111;			  //set up timer0 - prescaler 1:256 - 
+  	T1CON = T1CON_VALUE;          //set up timer1 - prescaler from osc_config.h - 100 Hz		- Enabled to start
+	T0CON = T0CON_VALUE;		  //set up timer0 - prescaler from osc_config.h - about 1s
 
-	// OPEN I2C for DS1340.
+	// Timer 3 stays off. Its interrupt flag is set by the high priority interrupt to run the
+	// fade stepping in the low priority interrupt, once per period.
+	T3CON = 0x00;
+	PIR2bits.TMR3IF = 0;
+	IPR2bits.TMR3IP = 0;		  //TMR3 LP
+	PIE2bits.TMR3IE = 1;		  //enable TMR3 interrupt
+	powerInit();
+
+	#if TIMEKEEPER_I2C
+	// OPEN I2C for the RTC.
 	OpenI2C2(MASTER, SLEW_OFF);
-	SSP2ADD = 79;
-	Delay10KTCYx(10);
+	SSP2ADD = SSP_ADD_VALUE;
+	#endif
 	
 	// Set 10ms pulse rate	
-  	TMR1H = 0x63;
-  	TMR1L = 0xBF;
+  	TMR1H = T1_RELOAD_H;
+  	TMR1L = T1_RELOAD_L;
 
 	// Enable Pullups for the buttons
 	INTCON2bits.RBPU=0;
 	WPUB = 0b00111001;
 
 	// Set initial compare modules
+	#ifdef OE_PWM
+	CCPR3L = 0;					// OE held high until the first applyBrightness
+	CCP3CON = 0x0E;				// CCP3 set to PWM, P3A active low
+	PR2 = OE_PR2;
+	T2CON = T2CON_VALUE;
+	oe_tris = 0;
+	CCP1CON = 0x00;				// CCP1 unused, OE does the blanking
+	#else
 	CCP1CON = 0x0A;				// CCP1 set to compare, CCP1IF rises on trigger
-	CCP2CON = 0x00;				// CCP2 set to off initially, to be turned on when fade occurs
 	IPR1bits.CCP1IP = 1;		// CCP1 Priority High
 	PIE1bits.CCP1IE = 1;		// CCP1 Interrupt Enable
+	#endif
+	CCP2CON = 0x00;				// CCP2 set to off initially, to be turned on when fade occurs
 	IPR2bits.CCP2IP = 1;		// CCP2 Priority High
 	PIE2bits.CCP2IE = 1;		// CCP2 Interrupt Enable
 	CCPR1H = GAMMA_TABLE_H[UNIVERSAL_BRIGHTNESS];
 	CCPR1L = GAMMA_TABLE_L[UNIVERSAL_BRIGHTNESS];
-	CCPTMRS0 = 0;				// All CCPs use timer 1
+	CCPTMRS0 = 0;				// All CCPs use timer 1 for compare, timer 2 for PWM
+	initializeGroups();			// CCP3 to CCP5 start off, see group.h
+	initializeEnergy();
 
-	// Zero all LEDs.
-	SHIFT_REGISTER_OUTPUTS[0] = 0x00;
-	SHIFT_REGISTER_OUTPUTS[1] = 0x00;
-	SHIFT_REGISTER_OUTPUTS[2] = 0x00;
-	SHIFT_REGISTER_OUTPUTS[3] = 0x00;
+	// Zero all LEDs, with nothing fading.
+	for(i = 0; i < 4; i++)
+	{
+		SHIFT_REGISTER_OUTPUTS[i] = 0x00;
+		FADING_MARKS[i] = 0xFF;
+		INCOMING_LEDS[i] = 0x00;
+	}
+	OP_MODE = STANDARD_OP;
+	PWM_PERIODS = 0;
+	ISR_FLAGS.DISPLAY_ENABLED = 1;
+	ISR_FLAGS.DEEP_DIM = 0;
+	ISR_FLAGS.POWER_FAIL = 0;
+	ISR_FLAGS.FAST_WANTED = 0;
+
+	// Clear whatever the chain powered up with, so LATCHED_FRAME and STAGED_FRAME start out true.
+	writeShifts(SHIFT_REGISTER_OUTPUTS, 4);
 	
-	// Initialize RTC seconds to zero, since they are never read.
-	RTC.seconds = 0;
+	// Dim the face overnight, and refade it every hour on the hour.
+	initializeSchedule();
+	scheduleEvent(NIGHT_START_HOUR, 0, ACTION_BRIGHTNESS, NIGHT_BRIGHTNESS, DAILY);
+	scheduleEvent(DAY_START_HOUR, 0, ACTION_BRIGHTNESS, DAY_BRIGHTNESS, DAILY);
+	scheduleEvent(EVERY_HOUR, 0, ACTION_ANIMATION, 0, DAILY);
+	#ifdef QUIET_HOURS
+	scheduleEvent(QUIET_START_HOUR, 0, ACTION_DISPLAY_OFF, 0, DAILY);
+	scheduleEvent(QUIET_END_HOUR, 0, ACTION_DISPLAY_ON, 0, DAILY);
+	#endif
+
+	// Light whatever was on the face before a reset straight away. The RTC is read once the display is running.
+	warm = snapshotLoad(DISPLAY_TARGET, &BRIGHTNESS_SETTING, &BRIGHTNESS_FINE);
+	if(warm)
+	{
+		for(i = 0; i < 4; i++)
+			SHIFT_REGISTER_OUTPUTS[i] = DISPLAY_TARGET[i];
 
-	// Turn on trickle charger with a 4k ohm resistor and no diode.
-	RTC.trickle_reg = TRICKLE_EN | DIODE_OFF | RES_4K;
+		// The snapshot is taken from the layers, so it has to be put back on one to survive the next save.
+		layerSet(LAYER_TIME, DISPLAY_TARGET);
+	}
+	applyBrightness();
 
-	// Keep the configuration at default.
-	RTC.control_reg = 0;
+	#ifdef HLVD_LEVEL
+	powerFailInit();
+	#endif
 
-	// Initialize the DS1340.
-	initializeDS1340(&RTC);
+	// Enable Global Interrupts
+	INTCONbits.GIEL = 1;
+	INTCONbits.GIEH = 1;
+	PROFILE_END();
 
-	// Read the time. If it was not reset, this will contain the last valid data. 
-	// If it was reset due to low cap voltage, this will contain 0:00.
-	readDS1340(&RTC);
-	HOURS = RTC.hours;
+	#if TIMEKEEPER_I2C
+	// Give the RTC time to settle, with the display already running.
+	Delay10KTCYx(DELAY_10KTCY(6));
+	#endif
+
+	// Start the clock source and read the time.
+	timekeeperInit(&RTC);
+	HOURS = RTC.hours % 12;
 	MINUTES = RTC.minutes; 
 
-	// Build initial display.
-	rebuildDisplay(SHIFT_REGISTER_OUTPUTS, INCOMING_LEDS, FADING_MARKS);
-	OP_MODE = startFading(UNIVERSAL_BRIGHTNESS, &FADING_BRIGHTNESS);
+	// The schedule only fires on the minute, so pick up whatever it would have set by now. A warm boot keeps the
+	// brightness from the snapshot, which may have been set by the buttons since the last scheduled change.
+	scheduleCatchUp(!warm);
 
-	// Enable Global Interrupts
-	INTCONbits.GIEH = 1;
+	// Fade from the restored face to the real time, or show it outright if there was nothing to restore.
+	showTime(warm ? TRANSITION_FADE : TRANSITION_INSTANT);
 
 	while(1)
 	{	
+		#ifdef HLVD_LEVEL
+		// The supply failed while the RTC was being talked to. That transaction is finished now.
+		if(ISR_FLAGS.POWER_FAIL)
+			powerFailSleep();
+		#endif
+
 		// If the brightness keys havent triggered in the last 10ms...
-		if(BTN_RDY == 1)
+		if(ISR_FLAGS.BTN_RDY == 1)
 		{
 			if(!brightness_up)
 			{
-				if(UNIVERSAL_BRIGHTNESS < 127)
-					UNIVERSAL_BRIGHTNESS++;
-				CCPR1H = GAMMA_TABLE_H[UNIVERSAL_BRIGHTNESS];
-				CCPR1L = GAMMA_TABLE_L[UNIVERSAL_BRIGHTNESS];
-				BTN_RDY = 0;
+				// Fine steps at the dark end, whole gamma entries above it.
+				if(BRIGHTNESS_SETTING < DITHER_THRESHOLD && BRIGHTNESS_FINE < DITHER_STEPS - 1)
+					BRIGHTNESS_FINE++;
+				else if(BRIGHTNESS_SETTING < 127)
+				{
+					BRIGHTNESS_SETTING++;
+					BRIGHTNESS_FINE = 0;
+				}
+				applyBrightness();
+				ISR_FLAGS.BTN_RDY = 0;
 			}
 			if(!brightness_down)
 			{
-				if(UNIVERSAL_BRIGHTNESS > 2)
-					UNIVERSAL_BRIGHTNESS--;
-				CCPR1H = GAMMA_TABLE_H[UNIVERSAL_BRIGHTNESS];
-				CCPR1L = GAMMA_TABLE_L[UNIVERSAL_BRIGHTNESS];
-				BTN_RDY = 0;
+				if(BRIGHTNESS_FINE > 0)
+					BRIGHTNESS_FINE--;
+				else if(BRIGHTNESS_SETTING > 2)
+				{
+					BRIGHTNESS_SETTING--;
+					if(BRIGHTNESS_SETTING < DITHER_THRESHOLD)
+						BRIGHTNESS_FINE = DITHER_STEPS - 1;
+				}
+				applyBrightness();
+				ISR_FLAGS.BTN_RDY = 0;
 			}
 		}
 
@@ -265,42 +520,70 @@ void main()
 			BTN_DOWN_D = 1;
 		
 		// When the time increment button is released:
-		// Increase the time 5 minutes, write it to DS1340, refresh display.
+		// Increase the time 5 minutes, write it to the RTC, refresh display.
 		if(BTN_DOWN_U && time_up)
 		{
 			BTN_DOWN_U = 0;
+			startCalibration();
 			timeIncrease();
-			RTC.hours = HOURS;
-			RTC.minutes = MINUTES;
-			writeDS1340(&RTC);
-			quickSwitch(SHIFT_REGISTER_OUTPUTS);
+			timekeeperWrite(&RTC);
+			scheduleCatchUp(0);
+			showTime(TRANSITION_INSTANT);
 		}	
 
 		// When the time decrement button is released:
-		// Round down to nearest 5 minutes, write it to DS1340, refresh display.
+		// Round down to nearest 5 minutes, write it to the RTC, refresh display.
 		if(BTN_DOWN_D && time_down)
 		{
 			BTN_DOWN_D = 0;
+			startCalibration();
 			timeDecrease();
-			RTC.hours = HOURS;
-			RTC.minutes = MINUTES;
-			writeDS1340(&RTC);
-			quickSwitch(SHIFT_REGISTER_OUTPUTS);
+			timekeeperWrite(&RTC);
+			scheduleCatchUp(0);
+			showTime(TRANSITION_INSTANT);
 		}		
 		
-		// If timer 0 elapsed, read the time, and if it is different then begin fading process.
-		if(INTCONbits.TMR0IF)
+		// If the minute has changed, begin fading process.
+		if(timekeeperPoll(&RTC))
 		{
-			readDS1340(&RTC);
-			if(RTC.minutes != MINUTES)
+			MINUTES = RTC.minutes;
+			HOURS = RTC.hours%12;
+
+			showTime(TRANSITION_FADE);
+
+			// Only the wheel slot for this minute is checked.
+			runSchedule(RTC.hours, MINUTES, scheduledAction);
+		}
+
+		// Account for the energy used over the periods since the last pass.
+		// The state is copied with the interrupt held off, and accounted for outside of it.
+		if(PWM_PERIODS)
+		{
+			unsigned char lit[4], marks[4];
+			unsigned char periods, fade, i;
+
+			ENTER_CRITICAL();
+			periods = PWM_PERIODS;
+			PWM_PERIODS = 0;
+			for(i = 0; i < 4; i++)
 			{
-				MINUTES = RTC.minutes;
-				HOURS = RTC.hours%12;
-				rebuildDisplay(SHIFT_REGISTER_OUTPUTS, INCOMING_LEDS, FADING_MARKS);
-				OP_MODE = startFading(UNIVERSAL_BRIGHTNESS, &FADING_BRIGHTNESS);
+				lit[i] = SHIFT_REGISTER_OUTPUTS[i];
+				marks[i] = FADING_MARKS[i];
 			}
-			INTCONbits.TMR0IF = 0;
-		}	
+			fade = (OP_MODE == STANDARD_OP) ? UNIVERSAL_BRIGHTNESS : FADING_LEVEL >> DITHER_BITS;
+			EXIT_CRITICAL();
+
+			if(!ISR_FLAGS.DISPLAY_ENABLED)
+				for(i = 0; i < 4; i++)
+					lit[i] = 0;
+			PROFILE_BEGIN(PROFILE_ENERGY);
+			energyAccount(lit, marks, UNIVERSAL_BRIGHTNESS, fade, periods);
+			PROFILE_END();
+
+			// The same periods time the calibration blink.
+			if(UI_MODE == UI_TIME_CAL)
+				calibrationTick(periods);
+		}
 	}
 }
 
@@ -313,8 +596,13 @@ void timeIncrease()
 	if(MINUTES > 55)
 	{
 		MINUTES = 0;
-		HOURS = (HOURS + 1) % 12;
+		RTC.hours = (RTC.hours + 1) % 24;
 	}
+	HOURS = RTC.hours % 12;
+
+	// The RTC read fills in the seconds, so they have to be zeroed for the RTC write.
+	RTC.minutes = MINUTES;
+	RTC.seconds = 0;
 }
 
 //! If rounds down to the nearest 5 minutes. I.E. if the time is 12:34:13, this will make it 12:30:00. If time is 12:30:XX, it will become 12:25:00.
@@ -327,13 +615,194 @@ void timeDecrease()
 	else
 	{
 		MINUTES = 55;
-		if(HOURS == 0)
-			HOURS = 11;
+		if(RTC.hours == 0)
+			RTC.hours = 23;
 		else
-			HOURS = HOURS - 1;
+			RTC.hours = RTC.hours - 1;
 	}
+	HOURS = RTC.hours % 12;
+
+	// As in timeIncrease, the new time starts from :00.
+	RTC.minutes = MINUTES;
+	RTC.seconds = 0;
+}
+
+/**
+@brief Sets UNIVERSAL_BRIGHTNESS and the CCP1 dither (or OE duty) from BRIGHTNESS_SETTING, clamped to the current budget.
+
+The budget is checked against every LED that is lit, about to fade in, or in the queued display. The fine steps are dropped if the budget
+lowers the brightness. The new dither is picked up by the interrupt at the start of the next period.
+This may be called with the interrupt already held off.
+*/
+void applyBrightness()
+{
+	unsigned char lit[4];
+	unsigned char i;
+	unsigned int level;
+	#ifdef OE_PWM
+	unsigned int duty;
+	#else
+	DITHER next;
+	#endif
+
+	for(i = 0; i < 4; i++)
+		lit[i] = SHIFT_REGISTER_OUTPUTS[i] | INCOMING_LEDS[i] | DISPLAY_TARGET[i];
+	UNIVERSAL_BRIGHTNESS = energyLimit(lit, BRIGHTNESS_SETTING);
+	if(UNIVERSAL_BRIGHTNESS == BRIGHTNESS_SETTING)
+		level = BRIGHTNESS_LEVEL(UNIVERSAL_BRIGHTNESS, BRIGHTNESS_FINE);
+	else
+		level = BRIGHTNESS_LEVEL(UNIVERSAL_BRIGHTNESS, 0);
+	#ifdef OE_PWM
+	// The duty registers are latched by the hardware at the end of each PWM period.
+	duty = ISR_FLAGS.DISPLAY_ENABLED ? OE_DUTY(level) : 0;
+	CCPR3L = duty >> 2;
+	CCP3CONbits.DC3B = duty;
+
+	ENTER_CRITICAL();
+	UNIVERSAL_LEVEL = level;
+	EXIT_CRITICAL();
+	#else
+	ditherSet(&next, level);
+	next.acc = 0;
+
+	ENTER_CRITICAL();
+	UNIVERSAL_LEVEL = level;
+	UNIVERSAL_DITHER = next;
+	ISR_FLAGS.DEEP_DIM = (level < BRIGHTNESS_LEVEL(DEEP_DIM_INDEX, 0));
+	EXIT_CRITICAL();
+	#endif
+
+	// Anything that changes the display or the brightness comes through here. The blink is left out, so a reset
+	// half way through one doesn't come back with the time words missing.
+	composeUnblinked(lit);
+	snapshotSave(lit, BRIGHTNESS_SETTING, BRIGHTNESS_FINE);
 }
 
+/**
+@brief Puts the current time on the time layer, and queues the display if that changed it.
+@param kind	One of the TRANSITION_ kinds from transition.h.
+*/
+void showTime(unsigned char kind)
+{
+	unsigned char frame[4];
+	PROFILE_BEGIN(PROFILE_SHOW_TIME);
+	quickSwitch(frame);
+	layerSet(LAYER_TIME, frame);
+	presentDisplay(kind);
+	PROFILE_END();
+}
+
+/**
+@brief Queues the composed display with the fade engine, if any layer has changed since it was last queued.
+@param kind	One of the TRANSITION_ kinds from transition.h.
+
+A fade already running is left to finish. The brightness budget is checked against the new display.
+*/
+void presentDisplay(unsigned char kind)
+{
+	if(!compose(DISPLAY_TARGET))
+		return;
+	ENTER_CRITICAL();
+	transitionPush(DISPLAY_TARGET, kind);
+	ISR_FLAGS.FAST_WANTED = 1;
+	EXIT_CRITICAL();
+	applyBrightness();
+}
+
+//! Enters UI_TIME_CAL, or restarts its timeout, with the time words showing.
+void startCalibration()
+{
+	UI_MODE = UI_TIME_CAL;
+	CAL_IDLE = 0;
+	CAL_PHASE = 0;
+	CAL_HIDDEN = 0;
+	layerClear(LAYER_BLINK);
+}
+
+/**
+@brief Blinks the time words in UI_TIME_CAL, and leaves it once the buttons have been idle long enough.
+@param periods	PWM periods since the last call.
+*/
+void calibrationTick(unsigned char periods)
+{
+	unsigned char hide[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+
+	CAL_IDLE += periods;
+	if(CAL_IDLE >= CAL_TIMEOUT_PERIODS)
+	{
+		UI_MODE = UI_CLOCK;
+		layerClear(LAYER_BLINK);
+		presentDisplay(TRANSITION_INSTANT);
+		return;
+	}
+
+	CAL_PHASE += periods;
+	if(CAL_PHASE < CAL_BLINK_PERIODS)
+		return;
+	CAL_PHASE = 0;
+
+	CAL_HIDDEN = !CAL_HIDDEN;
+	if(CAL_HIDDEN)
+	{
+		clearArray(hide, IT_IS);
+		layerSet(LAYER_BLINK, hide);
+	} else {
+		layerClear(LAYER_BLINK);
+	}
+	presentDisplay(TRANSITION_INSTANT);
+}
+
+/**
+@brief Carries out an action fired by the scheduler.
+@param action	One of the ACTION_ values from schedule.h.
+@param arg		The argument the event was scheduled with.
+*/
+void scheduledAction(unsigned char action, unsigned char arg)
+{
+	switch(action)
+	{
+		case(ACTION_BRIGHTNESS):
+			if(arg < 2 || arg > 127)
+				break;
+			BRIGHTNESS_SETTING = arg;
+			BRIGHTNESS_FINE = 0;
+			applyBrightness();
+			break;
+		case(ACTION_DISPLAY_OFF):
+			// CCP1 blanks the LEDs at the end of this period, and timer 1 will no longer relight them.
+			// With OE_PWM, applyBrightness drops the OE duty to zero instead.
+			ISR_FLAGS.DISPLAY_ENABLED = 0;
+			applyBrightness();
+			break;
+		case(ACTION_DISPLAY_ON):
+			ISR_FLAGS.DISPLAY_ENABLED = 1;
+			applyBrightness();
+			break;
+		case(ACTION_ANIMATION):
+			// Coalesces with a fade queued for this minute.
+			ENTER_CRITICAL();
+			transitionPush(DISPLAY_TARGET, TRANSITION_REFADE);
+			ISR_FLAGS.FAST_WANTED = 1;
+			EXIT_CRITICAL();
+			break;
+	}
+}
+
+/**
+@brief Applies the display state, and optionally the brightness, that the schedule would have left at the current time.
+@param brightness	Non-zero to catch up the brightness as well. Only done on a cold boot, so a brightness set with
+					the buttons is never thrown away.
+
+Called once the time is known at boot, and after the time buttons set it, since neither passes through
+the minute the events are due at.
+*/
+void scheduleCatchUp(unsigned char brightness)
+{
+	if(brightness)
+		catchUpSchedule(RTC.hours, RTC.minutes, ACTION_BIT(ACTION_BRIGHTNESS), scheduledAction);
+	catchUpSchedule(RTC.hours, RTC.minutes, ACTION_BIT(ACTION_DISPLAY_OFF) | ACTION_BIT(ACTION_DISPLAY_ON),
+					scheduledAction);
+}
 
 /**
 @brief Writes data out to the shift registers.
@@ -346,18 +815,145 @@ Writes out data, length bytes at a time. <br>
 */
 void writeShifts(unsigned char data[], unsigned char length)
 {
-	int i, j, k;
+	PROFILE_BEGIN(PROFILE_WRITE_SHIFTS);
 	st = 0;
+	stageShifts(data, length);
+	latchShifts();
+	PROFILE_END();
+}
+
+/**
+@brief Shifts data into the chain without latching it, so the outputs don't change until latchShifts.
+@param data[] Data to be shifted in.
+@param length Length of data to be shifted in.
+*/
+void stageShifts(unsigned char data[], unsigned char length)
+{
+	unsigned char i, bit, byte;
+
 	for(i = 0; i < length; i++)
-		for(j = 7; j >= 0; j--)
-			{
-				ds = (data[i] >> j) & 0x01;
-				sh = 1;
-				sh = 0;
-			}
+	{
+		byte = data[i];
+		STAGED_FRAME[i] = byte;
+		for(bit = 8; bit != 0; bit--)
+		{
+			ds = (byte & 0x80) ? 1 : 0;
+			sh = 1;
+			sh = 0;
+			byte <<= 1;
+		}
+	}
+}
+
+//! Latches the shift stage onto the outputs.
+void latchShifts()
+{
+	st = 0;
+	st = 1;
+	LATCHED_FRAME[0] = STAGED_FRAME[0];
+	LATCHED_FRAME[1] = STAGED_FRAME[1];
+	LATCHED_FRAME[2] = STAGED_FRAME[2];
+	LATCHED_FRAME[3] = STAGED_FRAME[3];
+}
+
+/**
+@brief Clocks zeros through the whole chain and latches them.
+
+With the data line held low, only the shift clock has to toggle, so this takes a fraction of the time writeShifts
+does. Used for the CCP1 blank and the deep dim pulse.
+*/
+void blankShifts()
+{
+	unsigned char i;
+	st = 0;
+	ds = 0;
+	for(i = 32; i != 0; i--)
+	{
+		sh = 1;
+		sh = 0;
+	}
 	st = 1;
+	LATCHED_FRAME[0] = LATCHED_FRAME[1] = LATCHED_FRAME[2] = LATCHED_FRAME[3] = 0x00;
+	STAGED_FRAME[0] = STAGED_FRAME[1] = STAGED_FRAME[2] = STAGED_FRAME[3] = 0x00;
+}
+
+//! Cuts the fading LEDs at the CCP2 edge. Called from InterruptHandlerHigh.
+void cutFading()
+{
+	unsigned char fade_array[4];
+	unsigned char i;
+
+	// Build a new array based on which should fade.
+	for(i = 0; i < 4; i++)
+	{
+		LIVE_MARKS[i] &= FADING_MARKS[i];
+		fade_array[i] = SHIFT_REGISTER_OUTPUTS[i] & LIVE_MARKS[i];
+	}		
+
+	// Write the LEDs back without the ones being faded
+	if(!SAME_FRAME(LATCHED_FRAME, fade_array))
+		writeShifts(fade_array, 4);
+
+	// Reset interrupt
+	PIR2bits.CCP2IF = 0;
 }
 
+//! Cuts the brightness groups whose CCP3 to CCP5 edges have passed. Called from InterruptHandlerHigh.
+void cutGroups()
+{
+	unsigned char group_array[4];
+	unsigned char i, cut3, cut4, cut5;
+
+	// Take the flags once, so an edge landing part way through is left for the next pass.
+	cut3 = PIR4bits.CCP3IF;
+	cut4 = PIR4bits.CCP4IF;
+	cut5 = PIR4bits.CCP5IF;
+	if(cut3)
+		PIR4bits.CCP3IF = 0;
+	if(cut4)
+		PIR4bits.CCP4IF = 0;
+	if(cut5)
+		PIR4bits.CCP5IF = 0;
+
+	for(i = 0; i < 4; i++)
+	{
+		if(cut3)
+			LIVE_MARKS[i] &= GROUP_KEEP[0][i];
+		if(cut4)
+			LIVE_MARKS[i] &= GROUP_KEEP[1][i];
+		if(cut5)
+			LIVE_MARKS[i] &= GROUP_KEEP[2][i];
+		group_array[i] = SHIFT_REGISTER_OUTPUTS[i] & LIVE_MARKS[i];
+	}
+
+	// Write the LEDs back without the groups that are done. After the CCP1 blank there is nothing to do,
+	// and the frame staged for the next period is kept.
+	if(!SAME_FRAME(LATCHED_FRAME, group_array))
+		writeShifts(group_array, 4);
+}
+
+#if POWER_SCALING
+/**
+@brief Switches the core between power states, if wanted. Called from the high priority interrupt once the LEDs
+are blanked, while CCPR1 still holds this period's blank.
+
+The core only drops where the gap before timer 1 overflows is long enough for the PLL to lock, so it can always
+come back up. A brighter level set while it is low leaves a shorter gap, so it goes up at the next blank whatever
+the gap. If the lock doesn't come in time, powerPeriod drops the attempt before the relight, and it is made again.
+*/
+void powerUpdate()
+{
+	unsigned char longGap = CCPR1H < POWER_GAP_H;
+
+	if(POWER_STATE == POWER_HIGH)
+	{
+		if(longGap && !ISR_FLAGS.FAST_WANTED && OP_MODE == STANDARD_OP)
+			powerDown();
+	} else if(ISR_FLAGS.FAST_WANTED || !longGap) {
+		powerUp();
+	}
+}
+#endif
 
 #pragma code InterruptVectorHigh = 0x08
 
@@ -370,91 +966,293 @@ void InterruptVectorHigh(void)
 }
 #pragma code
 
+#pragma code InterruptVectorLow = 0x18
+
+//! Code to reroute the low priority interrupt vector to InterruptHandlerLow.
+void InterruptVectorLow(void)
+{
+	_asm
+	goto InterruptHandlerLow
+	_endasm
+}
+#pragma code
+
 #pragma interrupt InterruptHandlerHigh
 
 /**
 @brief 
 Code to handle the interrupts from Timer1 overflow (100HZ turn on timer), 
 Compare Module 1 (main PWM turn off comparitor), 
-and Compare Module 2 (fade in/out LED turn off comparitor).
+Compare Module 2 (fade in/out LED turn off comparitor),
+and Compare Modules 3 to 5 (brightness group turn off comparitors).
+
+Only the output edges are handled here. Everything else that happens once a period is handed to InterruptHandlerLow,
+so that a compare edge is never held up behind it.
 */
 
 void InterruptHandlerHigh()
 {
-	// If interrupt is from timer 0 (100Hz):
+	#ifdef HLVD_LEVEL
+	// The supply is failing. Get the LEDs off and every timer stopped first, then sleep, leaving the charge for the RTC.
+	if(PIR2bits.HLVDIF)
+	{
+		blankShifts();
+		#ifdef OE_PWM
+		LATCbits.LATC6 = 1;
+		#endif
+		// Timer 5 is left running with TIMEKEEPER_SOSC, to keep the time. powerFailSleep counts its wakes.
+		T0CON = 0;
+		T1CON = 0;
+		T2CON = 0;
+		CCP1CON = 0;
+		CCP2CON = 0;
+		CCP3CON = 0;
+		CCP4CON = 0;
+		CCP5CON = 0;
+		PIR1 = 0;
+		PIR2 = 0;
+		PIR4 = 0;
+
+		// Sleeping in the middle of an I2C transaction could leave an RTC write half done.
+		if(!SSP2STATbits.S)
+			powerFailSleep();
+		ISR_FLAGS.POWER_FAIL = 1;
+		return;
+	}
+	#endif
+
+	// If interrupt is from timer 1 (100Hz):
 	if(PIR1bits.TMR1IF)
 	{
-		// Allow the brightness buttons to function again.
-		BTN_RDY = 1;			
-		switch(OP_MODE)
+		PROFILE_BEGIN(PROFILE_TMR1);
+		// Settle any switch up started in the last dark gap, before the clock could move mid period.
+		POWER_PERIOD();
+
+		// Pick this period's compare values. The fade was stepped by the low priority interrupt last period.
+		#ifndef OE_PWM
+		DITHER_NEXT(UNIVERSAL_DITHER, CCPR1H, CCPR1L);
+		#endif
+		// Timer 1 has only just rolled over, so it is nowhere near any compare value while they are written.
+		if(OP_MODE != STANDARD_OP)
 		{
-			// If nothing is fading, do nothing.
-			case(STANDARD_OP):
-				break;
-			// If LEDs are fading, make their brightness a little dimmer. If they are faded out completely, start the switchFade process.
-			case(FADING_OUT):
-				if(FADING_BRIGHTNESS > 0)
-				{
-					FADING_BRIGHTNESS--;
-					CCPR2H = GAMMA_TABLE_H[FADING_BRIGHTNESS];
-					CCPR2L = GAMMA_TABLE_L[FADING_BRIGHTNESS];
-				} else
-					OP_MODE = switchFades(SHIFT_REGISTER_OUTPUTS, FADING_MARKS, INCOMING_LEDS);
-				break;
-			// If LEDs 
-			case(FADING_IN):
-				if(FADING_BRIGHTNESS < UNIVERSAL_BRIGHTNESS)
-				{
-					FADING_BRIGHTNESS++;
-					CCPR2H = GAMMA_TABLE_H[FADING_BRIGHTNESS];
-					CCPR2L = GAMMA_TABLE_L[FADING_BRIGHTNESS];
-				} else 
-					OP_MODE = doneFading(FADING_MARKS, INCOMING_LEDS);
-				break;
+			DITHER_NEXT(FADE_DITHER, CCPR2H, CCPR2L);
+			CCP2CON = 0x0A;
+		}
+		if(GROUP_PENDING)
+			groupCommit();
+
+		// Turn on all valid LEDs. In the steady state CCP1 has already staged the frame, so this is one st pulse.
+		// With OE_PWM nothing blanks the chain, and the frame is normally still latched from last period.
+		if(ISR_FLAGS.DISPLAY_ENABLED)
+		{
+			if(!SAME_FRAME(LATCHED_FRAME, SHIFT_REGISTER_OUTPUTS))
+			{
+				if(SAME_FRAME(STAGED_FRAME, SHIFT_REGISTER_OUTPUTS))
+					latchShifts();
+				else
+					writeShifts(SHIFT_REGISTER_OUTPUTS, 4);
+			}
+			LIVE_MARKS[0] = LIVE_MARKS[1] = LIVE_MARKS[2] = LIVE_MARKS[3] = 0xFF;
+		} else {
+			LIVE_MARKS[0] = LIVE_MARKS[1] = LIVE_MARKS[2] = LIVE_MARKS[3] = 0x00;
 		}
-		// Turn on all valid LEDs
-		writeShifts(SHIFT_REGISTER_OUTPUTS, 4);
 
 		// Set to 10ms
-		TMR1H = 0x63;
-  		TMR1L = 0xBF;
+		TMR1H = T1_RELOAD_H;
+  		TMR1L = T1_RELOAD_L;
 
 		// Reset interrupt
 		PIR1bits.TMR1IF = 0;
-		
 
+		// Step the fade in the low priority interrupt.
+		PIR2bits.TMR3IF = 1;
+
+		#ifndef OE_PWM
+		// Make the deep dim pulse here. The wait is bounded by the period, in case the edge was already missed.
+		// Fading and group edges are cut inside the wait, and any that follow the blank only find zeros in LIVE_MARKS.
+		if(ISR_FLAGS.DEEP_DIM && ISR_FLAGS.DISPLAY_ENABLED)
+		{
+			while(!PIR1bits.CCP1IF && !PIR1bits.TMR1IF)
+			{
+				if(PIR2bits.CCP2IF)
+					cutFading();
+				if(PIR4bits.CCP3IF || PIR4bits.CCP4IF || PIR4bits.CCP5IF)
+					cutGroups();
+			}
+			blankShifts();
+			LIVE_MARKS[0] = LIVE_MARKS[1] = LIVE_MARKS[2] = LIVE_MARKS[3] = 0x00;
+			PIR1bits.CCP1IF = 0;
+			stageShifts(SHIFT_REGISTER_OUTPUTS, 4);
+			POWER_UPDATE();
+		}
+		#endif
+		PROFILE_END();
 	}
 	// If from comparitor 1 (overall brightness)
 	// If from comparitor 2 (fading algorithm)
 	if(PIR2bits.CCP2IF)
 	{
-		// Turn off fading LEDs
-		unsigned char fade_array[4];
-		unsigned char i;
-
-		// Build a new array based on which should fade.
-		for(i = 0; i < 4; i++)
-		{
-			fade_array[i] = SHIFT_REGISTER_OUTPUTS[i] & FADING_MARKS[i];
-		}		
-
-		// Write the LEDs back without the ones being faded
-		writeShifts(fade_array, 4);
-
-		// Reset interrupt
-		PIR2bits.CCP2IF = 0;
+		PROFILE_BEGIN(PROFILE_CCP2);
+		cutFading();
+		PROFILE_END();
 	}	
+
+	// If from comparitors 3 to 5 (brightness groups)
+	if(PIR4bits.CCP3IF || PIR4bits.CCP4IF || PIR4bits.CCP5IF)
+	{
+		PROFILE_BEGIN(PROFILE_GROUP);
+		cutGroups();
+		PROFILE_END();
+	}
 	
+	#ifndef OE_PWM
 	if(PIR1bits.CCP1IF)
 	{
-		unsigned char zero_array[4] = {0, 0, 0, 0};
+		PROFILE_BEGIN(PROFILE_CCP1);
 
-		// Turn off all LEDs
-		writeShifts(zero_array, 4);
+		// Turn off all LEDs, and keep any later edge from relighting them
+		blankShifts();
+		LIVE_MARKS[0] = LIVE_MARKS[1] = LIVE_MARKS[2] = LIVE_MARKS[3] = 0x00;
 		
 		// Reset interrupt
 		PIR1bits.CCP1IF = 0;
+
+		// Load the next period's frame behind the dark outputs, so timer 1 only has to latch it.
+		stageShifts(SHIFT_REGISTER_OUTPUTS, 4);
+
+		// Nothing else is due until timer 1 overflows.
+		POWER_UPDATE();
+		PROFILE_END();
 	}
+	#endif
 
 }
 
+
+
+#pragma interruptlow InterruptHandlerLow save=section(".tmpdata")
+
+/**
+@brief
+Code to handle the once a period work kicked off by InterruptHandlerHigh: re-arming the brightness buttons,
+counting periods, stepping the fade and moving between fade states.
+
+When nothing is fading, the next target queued with transitionPush is started. While more targets are waiting,
+the running fade is hurried along so the display catches up in a bounded number of periods.
+*/
+void InterruptHandlerLow()
+{
+	if(PIR2bits.TMR3IF)
+	{
+		DITHER next;
+		TRANSITION target;
+		unsigned char stepped = 0;
+		unsigned char step, changed, i;
+		PROFILE_BEGIN(PROFILE_FADE_STEP);
+
+		PIR2bits.TMR3IF = 0;
+
+		// Allow the brightness buttons to function again.
+		ISR_FLAGS.BTN_RDY = 1;
+		PWM_PERIODS++;
+		powerTick();
+
+		switch(OP_MODE)
+		{
+			// If nothing is fading, start on the next queued target.
+			case(STANDARD_OP):
+				if(!transitionPop(&target))
+				{
+					// Let the core drop back to the slow clock at the next blank.
+					ISR_FLAGS.FAST_WANTED = 0;
+					break;
+				}
+
+				if(target.kind == TRANSITION_INSTANT)
+				{
+					INTCONbits.GIEH = 0;
+					for(i = 0; i < 4; i++)
+						SHIFT_REGISTER_OUTPUTS[i] = target.frame[i];
+					INTCONbits.GIEH = 1;
+					break;
+				}
+
+				changed = 0;
+				for(i = 0; i < 4; i++)
+					changed |= SHIFT_REGISTER_OUTPUTS[i] ^ target.frame[i];
+				if(!changed && target.kind == TRANSITION_FADE)
+					break;
+
+				// CCP2 is off, so the high priority interrupt isn't reading the marks yet.
+				markChanges(SHIFT_REGISTER_OUTPUTS, target.frame, FADING_MARKS, INCOMING_LEDS);
+				if(target.kind == TRANSITION_REFADE)
+					fadeAll(SHIFT_REGISTER_OUTPUTS, FADING_MARKS, INCOMING_LEDS);
+				ditherSet(&next, FADE_CEILING);
+				stepped = 1;
+				INTCONbits.GIEH = 0;
+				OP_MODE = startFading(FADE_CEILING, &FADING_LEVEL);
+				INTCONbits.GIEH = 1;
+				break;
+			// If LEDs are fading, make their brightness a little dimmer. If they are faded out completely, start the switchFade process.
+			// Near the bottom the fade moves in fine steps, so it doesn't jump between the coarse gamma entries.
+			case(FADING_OUT):
+				if(FADING_LEVEL > 0)
+				{
+					step = FADE_STEP(FADING_LEVEL);
+					if(transitionPending())
+						step <<= TRANSITION_HURRY;
+					if(FADING_LEVEL > step)
+						FADING_LEVEL -= step;
+					else
+						FADING_LEVEL = 0;
+					ditherSet(&next, FADING_LEVEL);
+					stepped = 1;
+				} else {
+					// The high priority interrupt reads these arrays, so it waits for the switch.
+					INTCONbits.GIEH = 0;
+					OP_MODE = switchFades(SHIFT_REGISTER_OUTPUTS, FADING_MARKS, INCOMING_LEDS);
+					INTCONbits.GIEH = 1;
+				}
+				break;
+			// If LEDs 
+			case(FADING_IN):
+				if(FADING_LEVEL < FADE_CEILING)
+				{
+					step = FADE_STEP(FADING_LEVEL);
+					if(transitionPending())
+						step <<= TRANSITION_HURRY;
+					FADING_LEVEL += step;
+					if(FADING_LEVEL > FADE_CEILING)
+						FADING_LEVEL = FADE_CEILING;
+					ditherSet(&next, FADING_LEVEL);
+					stepped = 1;
+				} else {
+					INTCONbits.GIEH = 0;
+					OP_MODE = doneFading(FADING_MARKS, INCOMING_LEDS);
+					INTCONbits.GIEH = 1;
+				}
+				break;
+		}
+
+		// Hand the new compare values over in one piece, keeping the accumulator running.
+		if(stepped)
+		{
+			INTCONbits.GIEH = 0;
+			next.acc = FADE_DITHER.acc;
+			FADE_DITHER = next;
+			INTCONbits.GIEH = 1;
+		}
+		PROFILE_END();
+	}
+
+	#if TIMEKEEPER == TIMEKEEPER_SOSC
+	// Timer 5 counts the seconds off the crystal.
+	if(PIR5bits.TMR5IF)
+		timekeeperTick();
+	#endif
+
+	#if POWER_SCALING
+	if(PIR5bits.TMR4IF)
+		powerWait();
+	#endif
+}
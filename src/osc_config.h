@@ -0,0 +1,141 @@
+/**
+@file osc_config.h
+@brief Derives every oscillator dependent setting from a single F_OSC.
+
+Define F_OSC as 64000000, 32000000, 16000000 or 8000000 to pick the system clock. The internal oscillator and PLL
+settings, the timer 1 prescaler and reload, the timer 0 prescaler, the I2C baud divider, the delay counts and the
+gamma tables are all worked out from it at compile time. Slower clocks use less power.
+*/
+
+#ifndef OSC_CONFIG_H
+#define OSC_CONFIG_H
+
+//! The system clock, in Hz.
+#ifndef F_OSC
+#define F_OSC			64000000
+#endif
+
+//! The PWM refresh rate, in Hz.
+#define REFRESH_HZ		100
+
+//! The I2C bus clock, in Hz.
+#define I2C_BAUD		200000
+
+//! The largest error allowed between REFRESH_HZ and the derived refresh rate, in parts per million.
+#define REFRESH_TOLERANCE_PPM	100
+
+//!@name Oscillator dependent settings.
+//!@brief The HFINTOSC setting, PLL, timer 1 prescaler and timer 0 prescaler for each supported clock.
+//! Timer 0 is kept close to a 1 second overflow, as it paces the RTC reads.
+//!@{
+#if F_OSC == 64000000
+	#define OSC_IRCF		0b111
+	#define OSC_PLL			1
+	#define T1_PRESCALE		4
+	#define T1_CKPS			0b10
+	#define T0_PS			0b111
+#elif F_OSC == 32000000
+	#define OSC_IRCF		0b110
+	#define OSC_PLL			1
+	#define T1_PRESCALE		2
+	#define T1_CKPS			0b01
+	#define T0_PS			0b110
+#elif F_OSC == 16000000
+	#define OSC_IRCF		0b111
+	#define OSC_PLL			0
+	#define T1_PRESCALE		1
+	#define T1_CKPS			0b00
+	#define T0_PS			0b101
+#elif F_OSC == 8000000
+	#define OSC_IRCF		0b110
+	#define OSC_PLL			0
+	#define T1_PRESCALE		1
+	#define T1_CKPS			0b00
+	#define T0_PS			0b100
+#else
+	#error "F_OSC must be 64000000, 32000000, 16000000 or 8000000"
+#endif
+//!@}
+
+//!@name Low power state.
+//!@brief The slower clock power.c drops to during steady display. The timer 1 and timer 0 prescalers shrink by the
+//! same factor as the clock, so both timers keep counting at the same rate and no reload or gamma entry changes.
+//! POWER_SCALING is 0 where there is no slower clock that allows this. Only 64MHz switches: the 16MHz HFINTOSC is
+//! left running and just the PLL goes on and off, so timer 1 keeps its rate while the PLL locks. 32MHz needs the
+//! 8MHz HFINTOSC under the PLL, which would halve the timer 1 rate until the lock. OE_PWM has no dark gap to
+//! switch in (see power.h).
+//!@{
+#if F_OSC == 64000000 && !defined(OE_PWM)
+	#define POWER_SCALING	1
+	#define LOW_IRCF		0b111		//!< 16MHz HFINTOSC
+	#define LOW_PLL			0
+	#define LOW_T1_CKPS		0b00		//!< 1:1
+	#define LOW_T0_PS		0b101		//!< 1:64
+	#define PLL_LOCK_US		2000		//!< The longest the PLL takes to lock.
+	//! The CCPR1H a blank has to come in under to leave PLL_LOCK_US of dark gap, and a quarter again to spare for
+	//! the low priority interrupt to get to powerWait, before timer 1 overflows.
+	#define POWER_GAP_H		((unsigned char)((0x10000 - (unsigned long)T1_RATE / 1000 * PLL_LOCK_US * 5 / 4000) >> 8))
+	#if LOW_IRCF != OSC_IRCF
+		#error "The HFINTOSC must not change across a power switch."
+	#endif
+#else
+	#define POWER_SCALING	0
+#endif
+//!@}
+
+//! The instruction clock, in Hz.
+#define F_CY			(F_OSC / 4)
+
+//!@name Timer 1 (PWM period) settings.
+//!@{
+#define T1_RATE			(F_CY / T1_PRESCALE)					//!< Timer 1 counts per second.
+#define T1_PERIOD		(T1_RATE / REFRESH_HZ)					//!< Timer 1 counts per PWM period.
+#define T1_RELOAD		(0x10000 - T1_PERIOD - 1)				//!< Written to timer 1 at the start of each period.
+#define T1_RELOAD_H		((unsigned char)(T1_RELOAD >> 8))
+#define T1_RELOAD_L		((unsigned char)(T1_RELOAD & 0xFF))
+#define T1CON_VALUE		((T1_CKPS << 4) | 0b0111)				//!< Fosc/4, 16 bit reads, not synchronised, on.
+//!@}
+
+//! Timer 0 on, 16 bit, Fosc/4, prescaled by T0_PS.
+#define T0CON_VALUE		(0b10000000 | T0_PS)
+
+//! The I2C baud rate generator reload.
+#define SSP_ADD_VALUE	(F_OSC / (4 * I2C_BAUD) - 1)
+
+//! The count to pass to Delay10KTCYx for a delay of at least ms milliseconds. Must come out at 255 or less.
+#define DELAY_10KTCY(ms)	((unsigned char)(((unsigned long)(ms) * (F_CY / 1000) + 9999) / 10000))
+
+//!@name Gamma table entries.
+//!@brief Compare values for the gamma tables: the period start plus a square law share of the period.
+//!@{
+#define GAMMA(i)		(T1_RELOAD + (unsigned int)(((unsigned long)T1_PERIOD * (i) * (i) + 16383) / 16384))
+#define GAMMA_H(i)		((unsigned char)(GAMMA(i) >> 8))
+#define GAMMA_L(i)		((unsigned char)(GAMMA(i) & 0xFF))
+
+//!@name Output enable PWM, used when OE_PWM is defined.
+//!@brief Timer 2 runs the ECCP3 PWM at F_CY / 16 / 256, about 3.9kHz at 64MHz. OE_DUTY maps a dither level
+//! (see dither.h) onto the 10 bit duty with the same square law as GAMMA, so each level gives the same share of the
+//! period as its gamma entry, to within one 1/1024 step.
+//!@{
+#define OE_PR2			255
+#define T2CON_VALUE		0b00000110		//!< Timer 2 on, prescaler 1:16.
+#define OE_DUTY(level)	((unsigned int)(((unsigned long)(level) * (level) + 1023) >> 10))
+//!@}
+//!@}
+
+// The derived period has to fit in timer 1 and land close enough to REFRESH_HZ.
+#if T1_PERIOD > 0xFFFE
+	#error "Timer 1 period does not fit in 16 bits. Raise T1_PRESCALE."
+#endif
+// The reload is one count below the ideal, so the real period is T1_PERIOD + 1 counts.
+#if (T1_PERIOD + 1) * REFRESH_HZ > T1_RATE + T1_RATE / 1000000 * REFRESH_TOLERANCE_PPM
+	#error "Derived refresh rate is below REFRESH_HZ by more than REFRESH_TOLERANCE_PPM."
+#endif
+#if (T1_PERIOD + 1) * REFRESH_HZ < T1_RATE - T1_RATE / 1000000 * REFRESH_TOLERANCE_PPM
+	#error "Derived refresh rate is above REFRESH_HZ by more than REFRESH_TOLERANCE_PPM."
+#endif
+#if SSP_ADD_VALUE < 3 || SSP_ADD_VALUE > 255
+	#error "I2C_BAUD cannot be reached at this F_OSC."
+#endif
+
+#endif
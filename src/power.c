@@ -0,0 +1,139 @@
+#include <p18f26k22.h>
+#include "power.h"
+#include "osc_config.h"
+#include "timekeeper.h"
+
+volatile unsigned char POWER_STATE = POWER_HIGH;
+volatile unsigned char POWER_PENDING = 0;
+
+//! PWM periods spent in each state.
+static unsigned long POWER_RESIDENCY[2];
+
+static void powerCommit(void);
+
+void powerInit(void)
+{
+	POWER_RESIDENCY[POWER_LOW] = POWER_RESIDENCY[POWER_HIGH] = 0;
+
+	#if POWER_SCALING
+	// Timer 4 stays off. Its interrupt flag is set by powerUp to run powerWait in the low priority interrupt.
+	T4CON = 0x00;
+	PIR5bits.TMR4IF = 0;
+	IPR5bits.TMR4IP = 0;		// TMR4 LP
+	PIE5bits.TMR4IE = 1;
+	#endif
+}
+
+void powerUp(void)
+{
+	#if POWER_SCALING
+	// Only the PLL changes, so timer 1 keeps counting at the same rate from the 16MHz clock until it takes over.
+	OSCTUNEbits.PLLEN = OSC_PLL;
+	POWER_PENDING = 1;
+	PIR5bits.TMR4IF = 1;
+	#endif
+}
+
+void powerWait(void)
+{
+	#if POWER_SCALING
+	PIR5bits.TMR4IF = 0;
+
+	// The clock moves over by itself as soon as PLLRDY sets. The high priority interrupt is only held off for the
+	// test and the prescaler writes, and powerPeriod ends the wait if timer 1 overflows first.
+	while(POWER_PENDING)
+	{
+		INTCONbits.GIEH = 0;
+		if(POWER_PENDING && OSCCON2bits.PLLRDY)
+			powerCommit();
+		INTCONbits.GIEH = 1;
+	}
+	#endif
+}
+
+void powerPeriod(void)
+{
+	#if POWER_SCALING
+	if(!POWER_PENDING)
+		return;
+
+	// Nothing is lit yet. If the PLL still hasn't locked, turn it back off before the clock can move mid period.
+	if(OSCCON2bits.PLLRDY)
+	{
+		powerCommit();
+	} else {
+		OSCTUNEbits.PLLEN = LOW_PLL;
+		POWER_PENDING = 0;
+	}
+	#endif
+}
+
+void powerDown(void)
+{
+	#if POWER_SCALING
+	OSCTUNEbits.PLLEN = LOW_PLL;
+	T1CONbits.T1CKPS = LOW_T1_CKPS;
+	T0CONbits.T0PS = LOW_T0_PS;
+	POWER_STATE = POWER_LOW;
+	#endif
+}
+
+void powerTick(void)
+{
+	POWER_RESIDENCY[POWER_STATE]++;
+}
+
+unsigned long powerResidency(unsigned char state)
+{
+	return POWER_RESIDENCY[state];
+}
+
+//! Moves the timer prescalers over to the PLL clock. Called with the high priority interrupt held off.
+static void powerCommit(void)
+{
+	#if POWER_SCALING
+	T1CONbits.T1CKPS = T1_CKPS;
+	T0CONbits.T0PS = T0_PS;
+	POWER_STATE = POWER_HIGH;
+	POWER_PENDING = 0;
+	#endif
+}
+
+#ifdef HLVD_LEVEL
+void powerFailInit(void)
+{
+	// Trip on a falling supply, once the reference has settled.
+	HLVDCON = HLVD_LEVEL;
+	HLVDCONbits.HLVDEN = 1;
+	while(!HLVDCONbits.IRVST);
+	PIR2bits.HLVDIF = 0;
+	IPR2bits.HLVDIP = 1;
+	PIE2bits.HLVDIE = 1;
+}
+
+void powerFailSleep(void)
+{
+	INTCONbits.GIEH = 0;
+	INTCONbits.GIEL = 0;
+
+	// Turn the trip around, so the HLVD wakes the core when the supply rises again. With the interrupts off,
+	// the wake carries on after Sleep() instead of vectoring.
+	HLVDCONbits.VDIRMAG = 1;
+	PIR2bits.HLVDIF = 0;
+	OSCCONbits.IDLEN = 0;
+	while(1)
+	{
+		Sleep();
+		Nop();
+		if(PIR2bits.HLVDIF)
+			break;
+
+		#if TIMEKEEPER == TIMEKEEPER_SOSC
+		// Timer 5 still counts the time, and wakes the core once a second. Count it, and go back to sleep.
+		if(PIR5bits.TMR5IF)
+			timekeeperTick();
+		#endif
+	}
+	Reset();
+}
+#endif
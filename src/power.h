@@ -0,0 +1,90 @@
+/**
+@file power.h
+@brief Switches the core between a fast clock for fades and a slow clock for steady display.
+
+In POWER_HIGH the core runs at F_OSC. In POWER_LOW it runs from the 16MHz HFINTOSC with the PLL off, and the timer
+prescalers are cut to match (see osc_config.h), so the PWM period and every compare value stay exactly the same.
+The timers keep their rate across a switch as long as the prescalers change the moment the clock does.
+
+Both switches are made in the dark gap after the CCP1 blank, where nothing is lit until timer 1 overflows. The
+switch down is instant. The switch up has to wait for the PLL, and the clock moves over by itself as soon as PLLRDY
+sets, so the high priority interrupt only turns the PLL on. powerWait spins on PLLRDY in the low priority interrupt
+and moves the prescalers over the moment it sets. Should timer 1 overflow first, powerPeriod turns the PLL back off
+before anything is relit.
+
+The core only drops to POWER_LOW when the gap is longer than the PLL lock time (POWER_GAP_H), so at the brighter
+levels it stays in POWER_HIGH. OE_PWM has no dark gap, so it never switches. See osc_config.h for the clocks that
+can switch at all.
+*/
+
+#ifndef POWER_H
+#define POWER_H
+
+//!@name Power states.
+//!@{
+#define POWER_LOW		0
+#define POWER_HIGH		1
+//!@}
+
+//! The current power state.
+extern volatile unsigned char POWER_STATE;
+
+//! Set while powerUp waits on the PLL, until powerWait or powerPeriod ends the wait.
+extern volatile unsigned char POWER_PENDING;
+
+/**
+@brief Zeroes the residency counts, and sets up timer 4's interrupt to run powerWait. Called once at start up.
+*/
+void powerInit(void);
+
+/**
+@brief Starts the move to POWER_HIGH. Called from the high priority interrupt once the LEDs are blanked.
+This turns the PLL on and returns. The switch is finished by powerWait.
+*/
+void powerUp(void);
+
+/**
+@brief Waits for the PLL, then moves the timer prescalers over. Called from the low priority interrupt on TMR4IF.
+*/
+void powerWait(void);
+
+/**
+@brief Finishes or drops a switch up still waiting at the end of the period. Called at the start of each period,
+from the high priority interrupt, before the relight.
+*/
+void powerPeriod(void);
+
+/**
+@brief Moves to POWER_LOW at once. Called from the high priority interrupt once the LEDs are blanked.
+*/
+void powerDown(void);
+
+/**
+@brief Counts one PWM period towards the residency of the current state. Called once a period.
+*/
+void powerTick(void);
+
+/**
+@brief Gets how long the core has spent in a power state.
+@param state	POWER_LOW or POWER_HIGH.
+@return Returns the number of PWM periods spent in the state since power up.
+*/
+unsigned long powerResidency(unsigned char state);
+
+#ifdef HLVD_LEVEL
+/**
+@brief Starts watching the supply. Built in when HLVD_LEVEL is defined as the HLVDL trip point to use.
+Pick the trip point just under the lowest normal supply, so the PIC is still well above brown-out when it fires.
+*/
+void powerFailInit(void);
+
+/**
+@brief Sleeps until the supply is back above the trip point, then resets. Any other wake is slept through, after
+counting the second with TIMEKEEPER_SOSC.
+Called once the LEDs are blanked and the timers stopped, and never while an I2C transaction is open, so the DS1340
+only ever sees whole writes. Everything restarts through main(), which puts the face back up from snapshot.h.
+*/
+void powerFailSleep(void);
+#endif
+
+#endif
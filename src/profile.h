@@ -0,0 +1,41 @@
+/**
+@file profile.h
+@brief Marks the hot paths on port A so they can be timed in a simulator or on a logic analyser.
+
+Define PROFILE to build with the markers in. On entry to a marked path, RA0-RA3 are set to its PROFILE_ number, and
+on exit they go back to whatever was marked before, so an interrupt landing inside main() code shows up as its own
+stretch. With gpsim, attach a logic analyser or a stopwatch to PORTA and the cycles per path can be read straight off
+the trace. Without PROFILE the markers compile to nothing.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+//!@name Marked paths.
+//!@{
+#define PROFILE_WRITE_SHIFTS	1		//!< writeShifts()
+#define PROFILE_TMR1			2		//!< Timer 1 branch of InterruptHandlerHigh()
+#define PROFILE_CCP1			3		//!< CCP1 branch of InterruptHandlerHigh()
+#define PROFILE_CCP2			4		//!< CCP2 branch of InterruptHandlerHigh()
+#define PROFILE_FADE_STEP		5		//!< InterruptHandlerLow()
+#define PROFILE_SHOW_TIME		6		//!< Building and queuing the display for the time.
+#define PROFILE_RTC_READ		7		//!< Reading the RTC in timekeeperPoll()
+#define PROFILE_ENERGY			8		//!< Energy accounting in main().
+#define PROFILE_GROUP			9		//!< Brightness group branch of InterruptHandlerHigh()
+#define PROFILE_BOOT			10		//!< main() from reset until the interrupts are on. First light is at most a period later.
+//!@}
+
+#ifdef PROFILE
+	//! Sets RA0-RA3 as outputs for the markers.
+	#define PROFILE_INIT()		TRISA &= 0xF0; LATA &= 0xF0
+	//! Starts a marked path. Must be paired with PROFILE_END in the same block.
+	#define PROFILE_BEGIN(id)	{ unsigned char profile_prev = LATA; LATA = (profile_prev & 0xF0) | (id);
+	//! Ends a marked path.
+	#define PROFILE_END()		LATA = profile_prev; }
+#else
+	#define PROFILE_INIT()
+	#define PROFILE_BEGIN(id)	{
+	#define PROFILE_END()		}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#include <i2c.h>
+#include "rtc_bus.h"
+
+static void busStart(void);
+static void busWrite(unsigned char data);
+static unsigned char busRead(void);
+
+#ifdef I2C_STATS
+//! Bus use since the last clearBusStats().
+static RTC_BUS_STATS BUS_STATS;
+#endif
+
+/*
+Binary to BCD for 0-59, which covers every time field we write.
+
+Estimated codec cost on the PIC18 core:
+ - Encoding with / 10 and % 10 made two calls into the 8-bit divide helper, roughly 180 cycles.
+ - Decoding with / 16 and % 16, roughly 20 cycles.
+ - The table lookup below is an indexed table read, about 10 cycles.
+ - The nibble decode below is a swap, mask, MULLW and add, about 10 cycles.
+*/
+static const unsigned char BCD_TABLE[60] =
+{
+0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09,
+0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19,
+0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29,
+0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59
+};
+
+void rtcReadRegisters(unsigned char addr, unsigned char first, unsigned char *data, unsigned char count)
+{
+	busStart();
+	busWrite( addr | 0x00 );
+	busWrite( first );
+	busStart();
+	busWrite( addr | 0x01 );
+	while(1)
+	{
+		*data++ = busRead();
+		if(--count == 0)
+			break;
+		AckI2C2();
+	}
+	NotAckI2C2();
+	StopI2C2();
+}
+
+void rtcWriteRegisters(unsigned char addr, unsigned char first, unsigned char *data, unsigned char count)
+{
+	busStart();
+	busWrite( addr | 0x00 );
+	busWrite( first );
+	while(count--)
+		busWrite( *data++ );
+	StopI2C2();
+}
+
+unsigned char bcdEncode(unsigned char data)
+{
+	return BCD_TABLE[data];
+}
+
+unsigned char bcdDecode(unsigned char bcd)
+{
+	//      UPPER BIT	 LOWER BIT
+	return((bcd >> 4)*10 + (bcd & 0x0F));
+}
+
+// The bus calls, counted when I2C_STATS is defined. A repeated start counts as a start.
+static void busStart(void)
+{
+	#ifdef I2C_STATS
+	BUS_STATS.starts++;
+	#endif
+	StartI2C2();
+}
+
+static void busWrite(unsigned char data)
+{
+	#ifdef I2C_STATS
+	BUS_STATS.bytes++;
+	#endif
+	WriteI2C2(data);
+}
+
+static unsigned char busRead(void)
+{
+	#ifdef I2C_STATS
+	BUS_STATS.bytes++;
+	#endif
+	return ReadI2C2();
+}
+
+#ifdef I2C_STATS
+void getBusStats(RTC_BUS_STATS *stats)
+{
+	*stats = BUS_STATS;
+}
+
+void clearBusStats(void)
+{
+	BUS_STATS.starts = 0;
+	BUS_STATS.bytes = 0;
+}
+#endif
@@ -0,0 +1,69 @@
+/**
+@file rtc_bus.h
+@brief The I2C2 register access and BCD codec shared by the RTC drivers.
+
+Both the DS1340 and the DS3231 keep the time in BCD behind a register pointer, so every read is a burst from a
+first register and every write a burst to one. Define I2C_STATS to count the bus use of every call made through
+here, so the drivers can be compared on bus time.
+*/
+
+#ifndef RTC_BUS_H
+#define RTC_BUS_H
+
+/**
+@brief Burst reads registers from an RTC.
+@param addr		The 8 bit I2C address, with the R/W bit clear.
+@param first	The first register to read.
+@param data		Filled with count registers.
+@param count	The number of registers to read, at least 1.
+*/
+void rtcReadRegisters(unsigned char addr, unsigned char first, unsigned char *data, unsigned char count);
+
+/**
+@brief Burst writes registers to an RTC.
+@param addr		The 8 bit I2C address, with the R/W bit clear.
+@param first	The first register to write.
+@param data		The count registers to write.
+@param count	The number of registers to write.
+*/
+void rtcWriteRegisters(unsigned char addr, unsigned char first, unsigned char *data, unsigned char count);
+
+/**
+@brief Binary to BCD, from a table.
+@param data	The value, 0-59.
+@return Returns the BCD value.
+*/
+unsigned char bcdEncode(unsigned char data);
+
+/**
+@brief BCD to binary.
+@param bcd	The BCD value, with any flag bits already masked off.
+@return Returns the value.
+*/
+unsigned char bcdDecode(unsigned char bcd);
+
+#ifdef I2C_STATS
+/**
+* Bus use through rtcReadRegisters and rtcWriteRegisters, counted when I2C_STATS is defined.
+* Compare a driver change by clearing the counts, making the call and reading them back.
+*/
+typedef struct
+{
+	unsigned int starts;	//!< Start and repeated start conditions.
+	unsigned int bytes;		//!< Bytes moved either way, each with its ACK or NACK.
+} RTC_BUS_STATS;
+
+//! SCL clocks for a set of counts: 9 for each byte with its ACK, and about 2 for each start and its stop.
+#define BUS_CLOCKS(stats)	((unsigned long)(stats).bytes * 9 + (unsigned long)(stats).starts * 2)
+
+/**
+* Reads the bus counts.
+	@param stats Pointer to the RTC_BUS_STATS to fill in.
+*/
+void getBusStats(RTC_BUS_STATS *stats);
+
+/// Zeroes the bus counts.
+void clearBusStats(void);
+#endif
+
+#endif
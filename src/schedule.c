@@ -0,0 +1,120 @@
+#include "schedule.h"
+
+//! The event pool.
+static SCHEDULE_EVENT EVENTS[SCHEDULE_CAPACITY];
+
+//! The head of each minute's event list.
+static unsigned char SLOTS[SCHEDULE_SLOTS];
+
+//! The head of the free list.
+static unsigned char FREE_EVENTS;
+
+void initializeSchedule(void)
+{
+	unsigned char i;
+
+	for(i = 0; i < SCHEDULE_SLOTS; i++)
+		SLOTS[i] = SCHEDULE_NONE;
+
+	// Chain every event onto the free list.
+	for(i = 0; i < SCHEDULE_CAPACITY - 1; i++)
+		EVENTS[i].next = i + 1;
+	EVENTS[SCHEDULE_CAPACITY - 1].next = SCHEDULE_NONE;
+	FREE_EVENTS = 0;
+}
+
+unsigned char scheduleEvent(unsigned char hour, unsigned char minute, unsigned char action,
+							unsigned char arg, unsigned char repeat)
+{
+	unsigned char handle = FREE_EVENTS;
+
+	if(handle == SCHEDULE_NONE || minute >= SCHEDULE_SLOTS)
+		return SCHEDULE_NONE;
+
+	// Pop from the free list, push onto the head of the minute's slot.
+	FREE_EVENTS = EVENTS[handle].next;
+	EVENTS[handle].hour = hour;
+	EVENTS[handle].action = action;
+	EVENTS[handle].arg = arg;
+	EVENTS[handle].repeat = repeat;
+	EVENTS[handle].next = SLOTS[minute];
+	SLOTS[minute] = handle;
+	return handle;
+}
+
+void cancelEvent(unsigned char handle, unsigned char minute)
+{
+	unsigned char *link = &SLOTS[minute];
+
+	while(*link != SCHEDULE_NONE)
+	{
+		if(*link == handle)
+		{
+			*link = EVENTS[handle].next;
+			EVENTS[handle].next = FREE_EVENTS;
+			FREE_EVENTS = handle;
+			return;
+		}
+		link = &EVENTS[*link].next;
+	}
+}
+
+void runSchedule(unsigned char hour, unsigned char minute,
+				 void (*dispatch)(unsigned char action, unsigned char arg))
+{
+	unsigned char *link = &SLOTS[minute];
+	unsigned char current;
+
+	while(*link != SCHEDULE_NONE)
+	{
+		current = *link;
+		if(EVENTS[current].hour == hour || EVENTS[current].hour == EVERY_HOUR)
+		{
+			dispatch(EVENTS[current].action, EVENTS[current].arg);
+
+			// One-shot events go back on the free list.
+			if(EVENTS[current].repeat == ONCE)
+			{
+				*link = EVENTS[current].next;
+				EVENTS[current].next = FREE_EVENTS;
+				FREE_EVENTS = current;
+				continue;
+			}
+		}
+		link = &EVENTS[current].next;
+	}
+}
+
+void catchUpSchedule(unsigned char hour, unsigned char minute, unsigned char actions,
+					 void (*dispatch)(unsigned char action, unsigned char arg))
+{
+	unsigned int now = (unsigned int)hour * 60 + minute;
+	unsigned int age, best_age = DAY_MINUTES;
+	unsigned char slot, current, best = SCHEDULE_NONE;
+
+	for(slot = 0; slot < SCHEDULE_SLOTS; slot++)
+		for(current = SLOTS[slot]; current != SCHEDULE_NONE; current = EVENTS[current].next)
+		{
+			if(EVENTS[current].repeat != DAILY || !(ACTION_BIT(EVENTS[current].action) & actions))
+				continue;
+
+			// How long ago the event was last due, wrapping back across the hour or the day.
+			if(EVENTS[current].hour == EVERY_HOUR)
+				age = (minute + 60 - slot) % 60;
+			else
+			{
+				age = now + DAY_MINUTES - ((unsigned int)EVENTS[current].hour * 60 + slot);
+				if(age >= DAY_MINUTES)
+					age -= DAY_MINUTES;
+			}
+
+			if(age < best_age)
+			{
+				best_age = age;
+				best = current;
+			}
+		}
+
+	if(best != SCHEDULE_NONE)
+		dispatch(EVENTS[best].action, EVENTS[best].arg);
+}
@@ -0,0 +1,106 @@
+/**
+@file schedule.h
+@brief A small hashed timer wheel used to run actions at set times of day.
+
+The wheel has one slot for every minute of the hour. An event for HH:MM is hashed into slot MM and remembers its hour,
+so checking for due events on a minute change only ever walks the one slot for that minute. Events are kept in a fixed
+pool, so adding an event is a pop from the free list and a push onto the head of its slot.
+*/
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+//! The number of events that can be scheduled at once.
+#define SCHEDULE_CAPACITY	16
+
+//! The number of slots in the wheel, one for each minute of the hour.
+#define SCHEDULE_SLOTS		60
+
+//! Marks the end of a slot list, or a failed call to scheduleEvent.
+#define SCHEDULE_NONE		0xFF
+
+//! Passed as the hour to have an event fire every hour.
+#define EVERY_HOUR			0xFF
+
+//!@name Repeat modes.
+//!@{
+#define ONCE				0		//!< The event is removed after it fires.
+#define DAILY				1		//!< The event stays in the wheel and fires again the next day (or hour).
+//!@}
+
+//!@name Scheduled actions.
+//!@{
+#define ACTION_BRIGHTNESS	0		//!< Sets the universal brightness to the event's argument.
+#define ACTION_DISPLAY_OFF	1		//!< Blanks the display.
+#define ACTION_DISPLAY_ON	2		//!< Turns the display back on.
+#define ACTION_ANIMATION	3		//!< Fades the whole face out and back in.
+//!@}
+
+//! The bit for an action, for catchUpSchedule.
+#define ACTION_BIT(action)	(1 << (action))
+
+//! The minutes in a day.
+#define DAY_MINUTES			1440
+
+/**
+* A single event in the wheel.
+*/
+typedef struct
+{
+	unsigned char hour;		//!< The hour to fire at, 0-23, or EVERY_HOUR.
+	unsigned char action;	//!< One of the ACTION_ values.
+	unsigned char arg;		//!< An argument passed along with the action.
+	unsigned char repeat;	//!< ONCE or DAILY.
+	unsigned char next;		//!< The next event in the same slot (or free list), or SCHEDULE_NONE.
+} SCHEDULE_EVENT;
+
+/**
+@brief Empties the wheel and puts every event back on the free list.
+*/
+void initializeSchedule(void);
+
+/**
+@brief Adds an event to the wheel.
+@param hour		The hour to fire at, 0-23, or EVERY_HOUR.
+@param minute	The minute to fire at, 0-59.
+@param action	One of the ACTION_ values.
+@param arg		An argument handed back with the action.
+@param repeat	ONCE or DAILY.
+@return Returns a handle that can be passed to cancelEvent, or SCHEDULE_NONE if the wheel is full.
+*/
+unsigned char scheduleEvent(unsigned char hour, unsigned char minute, unsigned char action,
+							unsigned char arg, unsigned char repeat);
+
+/**
+@brief Removes an event from the wheel.
+@param handle	A handle returned by scheduleEvent.
+@param minute	The minute the event was scheduled for.
+*/
+void cancelEvent(unsigned char handle, unsigned char minute);
+
+/**
+@brief Fires every event due at the given time. Called once on each minute change.
+@param hour		The current hour, 0-23.
+@param minute	The current minute, 0-59.
+@param dispatch	Called with the action and argument of each due event.
+
+Only the slot for the given minute is walked. Events scheduled ONCE are removed as they fire.
+*/
+void runSchedule(unsigned char hour, unsigned char minute,
+				 void (*dispatch)(unsigned char action, unsigned char arg));
+
+/**
+@brief Fires the daily event, out of those with one of the given actions, that was due most recently.
+@param hour		The current hour, 0-23.
+@param minute	The current minute, 0-59.
+@param actions	The actions to look at, as ACTION_BIT values ORed together.
+@param dispatch	Called with the action and argument of the event found. Not called if there is none.
+
+Used to put the display into the state the schedule would have left it in, after the time was set or read at boot.
+Pass actions that set the same state together, such as ACTION_DISPLAY_OFF and ACTION_DISPLAY_ON, so only the
+latest of them is applied. The whole wheel is walked, looking back as far as a day.
+*/
+void catchUpSchedule(unsigned char hour, unsigned char minute, unsigned char actions,
+					 void (*dispatch)(unsigned char action, unsigned char arg));
+
+#endif
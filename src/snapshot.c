@@ -0,0 +1,50 @@
+#include <p18f26k22.h>
+#include "snapshot.h"
+
+static unsigned char snapshotCheck(void);
+
+// Uninitialized data is left alone by the C18 startup code, so it survives any reset but power-on.
+#pragma udata snapshot
+static SNAPSHOT SNAPSHOT_RAM;
+#pragma udata
+
+void snapshotSave(unsigned char *frame, unsigned char brightness, unsigned char fine)
+{
+	unsigned char i;
+
+	for(i = 0; i < 4; i++)
+		SNAPSHOT_RAM.frame[i] = frame[i];
+	SNAPSHOT_RAM.brightness = brightness;
+	SNAPSHOT_RAM.fine = fine;
+	SNAPSHOT_RAM.check = snapshotCheck();
+}
+
+unsigned char snapshotLoad(unsigned char *frame, unsigned char *brightness, unsigned char *fine)
+{
+	unsigned char i;
+
+	// NOT_POR is cleared by a power-on reset, and has to be set again for the next one to show.
+	if(!RCONbits.NOT_POR)
+	{
+		RCONbits.NOT_POR = 1;
+		return 0;
+	}
+	if(SNAPSHOT_RAM.check != snapshotCheck())
+		return 0;
+
+	for(i = 0; i < 4; i++)
+		frame[i] = SNAPSHOT_RAM.frame[i];
+	*brightness = SNAPSHOT_RAM.brightness;
+	*fine = SNAPSHOT_RAM.fine;
+	return 1;
+}
+
+static unsigned char snapshotCheck(void)
+{
+	unsigned char i;
+	unsigned char sum = SNAPSHOT_MAGIC + SNAPSHOT_RAM.brightness + SNAPSHOT_RAM.fine;
+
+	for(i = 0; i < 4; i++)
+		sum += SNAPSHOT_RAM.frame[i];
+	return sum;
+}
@@ -0,0 +1,44 @@
+/**
+@file snapshot.h
+@brief Keeps the last display and brightness in RAM that the startup code doesn't clear, for a fast restart.
+
+After a brown-out, watchdog or MCLR reset the RAM still holds what was on the face, so main() can light it again
+straight away and converge on the real time once the DS1340 has been read. A power-on reset or a bad check byte
+means there is nothing to show, and the face stays dark until the first read.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+//! Mixed into the check byte, so RAM of all zeros or all ones is not taken as a snapshot.
+#define SNAPSHOT_MAGIC	0x5A
+
+/**
+* The state kept across a reset.
+*/
+typedef struct
+{
+	unsigned char frame[4];		//!< The display last queued.
+	unsigned char brightness;	//!< BRIGHTNESS_SETTING
+	unsigned char fine;			//!< BRIGHTNESS_FINE
+	unsigned char check;		//!< SNAPSHOT_MAGIC plus the sum of the bytes above.
+} SNAPSHOT;
+
+/**
+@brief Records the display and brightness. Cheap enough to call on every change.
+@param frame		The 4 byte display.
+@param brightness	The brightness setting.
+@param fine			The fine brightness steps.
+*/
+void snapshotSave(unsigned char *frame, unsigned char brightness, unsigned char fine);
+
+/**
+@brief Fetches the snapshot left from before the last reset. Must be called once, early in main().
+@param frame		Filled with the 4 byte display.
+@param brightness	Filled with the brightness setting.
+@param fine			Filled with the fine brightness steps.
+@return Returns 1 if the snapshot was good, or 0 after a power-on reset or a bad check byte, leaving the outputs alone.
+*/
+unsigned char snapshotLoad(unsigned char *frame, unsigned char *brightness, unsigned char *fine);
+
+#endif
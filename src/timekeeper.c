@@ -0,0 +1,251 @@
+#include <p18f26k22.h>
+#include "timekeeper.h"
+#include "profile.h"
+
+#if TIMEKEEPER == TIMEKEEPER_DS1340
+#include "ds_1340.h"
+
+//! The DS1340 configuration, and the last time read from it.
+static DS_1340 DS1340;
+
+static void copyTime(CLOCK_TIME *now);
+
+void timekeeperInit(CLOCK_TIME *now)
+{
+	// Turn on trickle charger with a 4k ohm resistor and no diode, and keep the configuration at default.
+	DS1340.trickle_reg = TRICKLE_EN | DIODE_OFF | RES_4K;
+	DS1340.control_reg = 0;
+	initializeDS1340(&DS1340);
+
+	// If the DS1340 was not reset, this will contain the last valid data.
+	// If it was reset due to low cap voltage, this will contain 0:00.
+	readDS1340(&DS1340);
+	copyTime(now);
+}
+
+void timekeeperWrite(CLOCK_TIME *now)
+{
+	DS1340.seconds = now->seconds;
+	DS1340.minutes = now->minutes;
+	DS1340.hours = now->hours;
+	writeDS1340(&DS1340);
+}
+
+unsigned char timekeeperPoll(CLOCK_TIME *now)
+{
+	unsigned char minutes = DS1340.minutes;
+
+	if(!INTCONbits.TMR0IF)
+		return 0;
+	INTCONbits.TMR0IF = 0;
+
+	PROFILE_BEGIN(PROFILE_RTC_READ);
+	readDS1340(&DS1340);
+	PROFILE_END();
+	if(DS1340.minutes == minutes)
+		return 0;
+	copyTime(now);
+	return 1;
+}
+
+static void copyTime(CLOCK_TIME *now)
+{
+	now->seconds = DS1340.seconds;
+	now->minutes = DS1340.minutes;
+	now->hours = DS1340.hours;
+}
+
+#elif TIMEKEEPER == TIMEKEEPER_DS3231
+#include "rtc_bus.h"
+
+//!@name The DS3231 registers and bits used here.
+//!@{
+#define DS3231_ADDR		0b11010000
+#define DS3231_SECONDS	0x00
+#define DS3231_ALARM2	0x0B		//!< Alarm 2 minutes, hours and day, in that order.
+#define DS3231_CONTROL	0x0E
+#define DS3231_STATUS	0x0F
+#define DS3231_A2M		0x80		//!< Alarm field bit. Set to leave that field out of the match.
+#define DS3231_INTCN	0x04		//!< Control register. Alarms drive INT, with the square wave off.
+#define DS3231_OSF		0x80		//!< Status register. Set when the oscillator has stopped.
+#define DS3231_A2F		0x02		//!< Status register. Set when alarm 2 matches.
+#define DS3231_HOURS_MASK	0x3F	//!< The hours in 24 hour mode.
+//!@}
+
+//! The minute last handed out, so a stray A2F is not taken for a minute change.
+static unsigned char LAST_MINUTE;
+
+static void readTime(CLOCK_TIME *now);
+
+void timekeeperInit(CLOCK_TIME *now)
+{
+	unsigned char regs[3];
+
+	// With every field masked, alarm 2 matches at 00 seconds of every minute.
+	regs[0] = regs[1] = regs[2] = DS3231_A2M;
+	rtcWriteRegisters(DS3231_ADDR, DS3231_ALARM2, regs, 3);
+
+	// Oscillator on, square wave off and both alarm interrupts off. A2F is still set on a match.
+	regs[0] = DS3231_INTCN;
+	rtcWriteRegisters(DS3231_ADDR, DS3231_CONTROL, regs, 1);
+
+	// If the oscillator stopped, the time registers can't be trusted, so start again from 0:00.
+	rtcReadRegisters(DS3231_ADDR, DS3231_STATUS, regs, 1);
+	if(regs[0] & DS3231_OSF)
+	{
+		now->seconds = now->minutes = now->hours = 0;
+		timekeeperWrite(now);
+	}
+	regs[0] = 0x00;
+	rtcWriteRegisters(DS3231_ADDR, DS3231_STATUS, regs, 1);
+
+	readTime(now);
+	LAST_MINUTE = now->minutes;
+}
+
+void timekeeperWrite(CLOCK_TIME *now)
+{
+	unsigned char regs[3];
+
+	regs[0] = bcdEncode(now->seconds);
+	regs[1] = bcdEncode(now->minutes);
+	regs[2] = bcdEncode(now->hours);
+	rtcWriteRegisters(DS3231_ADDR, DS3231_SECONDS, regs, 3);
+	LAST_MINUTE = now->minutes;
+}
+
+unsigned char timekeeperPoll(CLOCK_TIME *now)
+{
+	unsigned char status;
+	CLOCK_TIME read;
+
+	if(!INTCONbits.TMR0IF)
+		return 0;
+	INTCONbits.TMR0IF = 0;
+
+	// One byte most seconds. The time is only read once the alarm says the minute has turned.
+	PROFILE_BEGIN(PROFILE_RTC_READ);
+	rtcReadRegisters(DS3231_ADDR, DS3231_STATUS, &status, 1);
+	if(status & DS3231_A2F)
+	{
+		// A2F only clears when written with a 0. OSF is written back as it was.
+		status &= ~DS3231_A2F;
+		rtcWriteRegisters(DS3231_ADDR, DS3231_STATUS, &status, 1);
+		readTime(&read);
+	} else {
+		read.minutes = LAST_MINUTE;
+	}
+	PROFILE_END();
+
+	if(read.minutes == LAST_MINUTE)
+		return 0;
+	*now = read;
+	LAST_MINUTE = read.minutes;
+	return 1;
+}
+
+static void readTime(CLOCK_TIME *now)
+{
+	unsigned char regs[3];
+
+	rtcReadRegisters(DS3231_ADDR, DS3231_SECONDS, regs, 3);
+	now->seconds = bcdDecode(regs[0]);
+	now->minutes = bcdDecode(regs[1]);
+	now->hours = bcdDecode(regs[2] & DS3231_HOURS_MASK);
+}
+
+#elif TIMEKEEPER == TIMEKEEPER_SOSC
+
+//! Mixed into the check byte, so RAM of all zeros or all ones is not taken as a time.
+#define SOSC_MAGIC	0xA5
+
+//! Timer 5 clocked from the secondary oscillator, 1:1, not synchronized so it counts in sleep, and on.
+#define T5CON_SOSC	0b10001101
+
+static unsigned char soscCheck(void);
+
+// Uninitialized data is left alone by the C18 startup code, so the time survives any reset but power-on.
+#pragma udata sosc_time
+//! The time, counted by timekeeperTick in the low priority interrupt.
+static volatile CLOCK_TIME SOSC_TIME;
+//! SOSC_MAGIC plus the sum of SOSC_TIME.
+static volatile unsigned char SOSC_CHECK;
+#pragma udata
+
+//! Set by timekeeperTick when the minute turns, and cleared by timekeeperPoll.
+static volatile unsigned char MINUTE_TURNED;
+
+void timekeeperInit(CLOCK_TIME *now)
+{
+	// A warm reset, or a wake from powerFailSleep, keeps the time. After a power loss it starts from 0:00.
+	if(SOSC_CHECK == soscCheck() && SOSC_TIME.seconds < 60 && SOSC_TIME.minutes < 60 && SOSC_TIME.hours < 24)
+	{
+		now->seconds = SOSC_TIME.seconds;
+		now->minutes = SOSC_TIME.minutes;
+		now->hours = SOSC_TIME.hours;
+	} else {
+		now->seconds = now->minutes = now->hours = 0;
+	}
+	timekeeperWrite(now);
+
+	T5CON = T5CON_SOSC;
+	PIR5bits.TMR5IF = 0;
+	IPR5bits.TMR5IP = 0;		// TMR5 LP
+	PIE5bits.TMR5IE = 1;
+}
+
+void timekeeperWrite(CLOCK_TIME *now)
+{
+	INTCONbits.GIEL = 0;
+	TMR5H = 0x80;
+	TMR5L = 0x00;
+	SOSC_TIME.seconds = now->seconds;
+	SOSC_TIME.minutes = now->minutes;
+	SOSC_TIME.hours = now->hours;
+	SOSC_CHECK = soscCheck();
+	MINUTE_TURNED = 0;
+	INTCONbits.GIEL = 1;
+}
+
+unsigned char timekeeperPoll(CLOCK_TIME *now)
+{
+	if(!MINUTE_TURNED)
+		return 0;
+
+	INTCONbits.GIEL = 0;
+	MINUTE_TURNED = 0;
+	now->seconds = SOSC_TIME.seconds;
+	now->minutes = SOSC_TIME.minutes;
+	now->hours = SOSC_TIME.hours;
+	INTCONbits.GIEL = 1;
+	return 1;
+}
+
+void timekeeperTick()
+{
+	// Overflow again after 32768 counts, one second. Setting the top bit keeps any counts since the overflow.
+	TMR5H |= 0x80;
+	PIR5bits.TMR5IF = 0;
+
+	if(++SOSC_TIME.seconds < 60)
+	{
+		SOSC_CHECK++;
+		return;
+	}
+	SOSC_TIME.seconds = 0;
+	if(++SOSC_TIME.minutes == 60)
+	{
+		SOSC_TIME.minutes = 0;
+		if(++SOSC_TIME.hours == 24)
+			SOSC_TIME.hours = 0;
+	}
+	SOSC_CHECK = soscCheck();
+	MINUTE_TURNED = 1;
+}
+
+static unsigned char soscCheck(void)
+{
+	return SOSC_MAGIC + SOSC_TIME.seconds + SOSC_TIME.minutes + SOSC_TIME.hours;
+}
+
+#endif
@@ -0,0 +1,84 @@
+/**
+@file timekeeper.h
+@brief Keeps the time of day, behind one interface for each of the clock sources the board can be built with.
+
+Pick the source with TIMEKEEPER when building. The default is TIMEKEEPER_DS1340.
+ - TIMEKEEPER_DS1340 reads the DS1340 over I2C2 once timer 0 overflows, about once a second.
+ - TIMEKEEPER_DS3231 sets alarm 2 of a DS3231 to match once a minute. Each timer 0 overflow reads only its status
+   register, and the time is read only once A2F shows the minute has turned.
+ - TIMEKEEPER_SOSC counts a 32.768kHz crystal on the secondary oscillator with timer 5, and keeps the time in the
+   low priority interrupt. There is no bus traffic at all. Timer 1 is the PWM time base, so timer 5 is used instead.
+   SOSCO and SOSCI are on RC0 and RC1, where the shift register clock normally is, so this build moves the clock
+   to RC5 (see SH_BIT in main.c). The board has to be wired to match.
+   The time is kept in RAM the startup code leaves alone, so it survives a warm reset. Timer 5 keeps counting
+   through powerFailSleep. Only a power loss starts it again from 0:00.
+
+Every source raises the same minute change through timekeeperPoll, so the display code never reads a clock itself.
+*/
+
+#ifndef TIMEKEEPER_H
+#define TIMEKEEPER_H
+
+//!@name Clock sources, for TIMEKEEPER.
+//!@{
+#define TIMEKEEPER_DS1340	0
+#define TIMEKEEPER_DS3231	1
+#define TIMEKEEPER_SOSC		2
+//!@}
+
+#ifndef TIMEKEEPER
+#define TIMEKEEPER			TIMEKEEPER_DS1340
+#endif
+
+#if TIMEKEEPER == TIMEKEEPER_SOSC
+	//! Set when the source is on the I2C2 bus, so main knows to open it.
+	#define TIMEKEEPER_I2C	0
+#elif TIMEKEEPER == TIMEKEEPER_DS1340 || TIMEKEEPER == TIMEKEEPER_DS3231
+	#define TIMEKEEPER_I2C	1
+#else
+	#error "TIMEKEEPER must be TIMEKEEPER_DS1340, TIMEKEEPER_DS3231 or TIMEKEEPER_SOSC."
+#endif
+
+/**
+* A time of day, the same for every source.
+*/
+typedef struct
+{
+	unsigned char seconds;		//!< Contains the seconds, 0-59
+	unsigned char hours;		//!< Contains the hours, 0-23
+	unsigned char minutes;		//!< Contains the minutes, 0-59
+} CLOCK_TIME;
+
+/**
+@brief Starts the clock source, and reads the time it holds.
+@param now	Filled in with the current time. A source that lost its time starts from 0:00.
+
+For the I2C sources the bus must already be open, and the chip given time to settle since power up.
+*/
+void timekeeperInit(CLOCK_TIME *now);
+
+/**
+@brief Sets the time. The seconds are restarted from now->seconds.
+@param now	The time to set.
+*/
+void timekeeperWrite(CLOCK_TIME *now);
+
+/**
+@brief Checks for a minute change. Called on every pass of the main loop.
+@param now	Filled in with the new time when the minute has changed, and left alone otherwise.
+@return Returns 1 once for each change of minute the clock makes on its own. A time set by timekeeperWrite is not
+reported, as the caller already knows it.
+
+This costs a flag test on most passes. Only the I2C sources touch the bus, and only once timer 0 has overflowed.
+*/
+unsigned char timekeeperPoll(CLOCK_TIME *now);
+
+#if TIMEKEEPER == TIMEKEEPER_SOSC
+/**
+@brief Counts a second. Called from InterruptHandlerLow when TMR5IF is set, and clears it.
+Also called from powerFailSleep, for the seconds that wake the core while it waits out a failing supply.
+*/
+void timekeeperTick(void);
+#endif
+
+#endif
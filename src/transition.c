@@ -0,0 +1,52 @@
+#include "transition.h"
+
+//! The queue, oldest at TRANSITION_HEAD.
+static TRANSITION TRANSITIONS[TRANSITION_DEPTH];
+static unsigned char TRANSITION_HEAD = 0;
+static unsigned char TRANSITION_COUNT = 0;
+
+void transitionPush(unsigned char *frame, unsigned char kind)
+{
+	TRANSITION *slot;
+	unsigned char i;
+
+	if(TRANSITION_COUNT > 0)
+	{
+		slot = &TRANSITIONS[(TRANSITION_HEAD + TRANSITION_COUNT - 1) % TRANSITION_DEPTH];
+
+		// Coalesce with the newest target if it is the same sort, or if there is no room left.
+		if((slot->kind == TRANSITION_INSTANT) == (kind == TRANSITION_INSTANT))
+		{
+			if(slot->kind > kind)
+				kind = slot->kind;
+		}
+		else if(TRANSITION_COUNT < TRANSITION_DEPTH)
+		{
+			slot = &TRANSITIONS[(TRANSITION_HEAD + TRANSITION_COUNT) % TRANSITION_DEPTH];
+			TRANSITION_COUNT++;
+		}
+	} else {
+		slot = &TRANSITIONS[TRANSITION_HEAD];
+		TRANSITION_COUNT = 1;
+	}
+
+	for(i = 0; i < 4; i++)
+		slot->frame[i] = frame[i];
+	slot->kind = kind;
+}
+
+unsigned char transitionPending(void)
+{
+	return TRANSITION_COUNT;
+}
+
+unsigned char transitionPop(TRANSITION *next)
+{
+	if(TRANSITION_COUNT == 0)
+		return 0;
+
+	*next = TRANSITIONS[TRANSITION_HEAD];
+	TRANSITION_HEAD = (TRANSITION_HEAD + 1) % TRANSITION_DEPTH;
+	TRANSITION_COUNT--;
+	return 1;
+}
@@ -0,0 +1,58 @@
+/**
+@file transition.h
+@brief A small queue of display targets for the fade engine to work through in order.
+
+main() pushes the frame it wants shown, and how it should get there. The low priority interrupt pops the next target
+whenever no fade is running, so a fade in progress is never changed under it. Targets that pile up are coalesced into
+the newest one, so the queue never holds more than TRANSITION_DEPTH entries and the face always ends up on the latest.
+*/
+
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+//! The number of targets that can be queued.
+#define TRANSITION_DEPTH	4
+
+//! While targets are waiting, a running fade steps this many times faster (as a shift).
+#define TRANSITION_HURRY	2
+
+//!@name Transition kinds.
+//!@{
+#define TRANSITION_INSTANT	0		//!< Switch to the target at the start of the next period.
+#define TRANSITION_FADE		1		//!< Fade out the LEDs that go off, then fade in the LEDs that come on.
+#define TRANSITION_REFADE	2		//!< Fade the whole face out, then the whole target in.
+//!@}
+
+/**
+* A queued display target.
+*/
+typedef struct
+{
+	unsigned char frame[4];		//!< The LEDs to show, as in SHIFT_REGISTER_OUTPUTS.
+	unsigned char kind;			//!< One of the TRANSITION_ kinds.
+} TRANSITION;
+
+/**
+@brief Queues a display target. Must be called with the interrupts held off.
+@param frame	Points to an array of 4 unsigned chars containing the LEDs to show.
+@param kind		One of the TRANSITION_ kinds.
+
+If the newest queued target is of the same sort (instant, or either kind of fade) it is replaced by this one, keeping
+the stronger fade. A full queue also replaces its newest target.
+*/
+void transitionPush(unsigned char *frame, unsigned char kind);
+
+/**
+@brief Checks whether any targets are waiting.
+@return Returns the number of queued targets.
+*/
+unsigned char transitionPending(void);
+
+/**
+@brief Takes the oldest target off the queue. Only called from the interrupt.
+@param next		Points to the TRANSITION to copy it into.
+@return Returns 1 if a target was taken, 0 if the queue was empty.
+*/
+unsigned char transitionPop(TRANSITION *next);
+
+#endif